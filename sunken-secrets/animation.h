@@ -11,17 +11,25 @@ public:
 	{ 
 		return timer.getLength();
 	}
-	int currentFrame() const 
+	int currentFrame(double now) const 
 	{ 
-		return static_cast<int>(timer.getTime() / timer.getLength() * frameCount);
+		return static_cast<int>(timer.getTime(now) / timer.getLength() * frameCount);
 	}
-	void step(float deltaTime) 
-	{ 
-		timer.step(deltaTime);
+	void reset(double now)
+	{
+		timer.reset(now);
+	}
+	bool isDone(double now) const
+	{
+		return timer.isTimeout(now);
+	}
+	Timer &getTimer()
+	{
+		return timer;
 	}
-	bool isDone() const
+	const Timer &getTimer() const
 	{
-		return timer.isTimeout();
+		return timer;
 	}
 private:
 	Timer timer;
@@ -0,0 +1,247 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include "timer_wheel.h"
+
+// fixed size blocks for coroutine frames so starting a behaviour does not go to the heap,
+// frames bigger than a block fall back to operator new
+class FramePool
+{
+public:
+	static const size_t BLOCK_SIZE = 256;
+	static const size_t BLOCKS_PER_PAGE = 64;
+
+	static void *allocate(size_t size)
+	{
+		if (size > BLOCK_SIZE)
+		{
+			return ::operator new(size);
+		}
+		if (!freeList)
+		{
+			pages.push_back(std::make_unique<Block[]>(BLOCKS_PER_PAGE));
+			for (size_t i = 0; i < BLOCKS_PER_PAGE; i++)
+			{
+				pages.back()[i].next = freeList;
+				freeList = &pages.back()[i];
+			}
+		}
+		Block *block = freeList;
+		freeList = block->next;
+		return block;
+	}
+	static void deallocate(void *p, size_t size)
+	{
+		if (size > BLOCK_SIZE)
+		{
+			::operator delete(p);
+			return;
+		}
+		Block *block = static_cast<Block *>(p);
+		block->next = freeList;
+		freeList = block;
+	}
+private:
+	union Block
+	{
+		Block *next;
+		alignas(std::max_align_t) std::byte storage[BLOCK_SIZE];
+	};
+	static inline Block *freeList = nullptr;
+	static inline std::vector<std::unique_ptr<Block[]>> pages;
+};
+
+class BehaviourScheduler;
+
+// return type of a behaviour coroutine, hand it to BehaviourScheduler::spawn to run it
+class Behaviour
+{
+public:
+	struct promise_type
+	{
+		BehaviourScheduler *scheduler = nullptr;
+		TimerId sleepTimer = NO_TIMER;
+
+		Behaviour get_return_object()
+		{
+			return Behaviour(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+
+		static void *operator new(size_t size)
+		{
+			return FramePool::allocate(size);
+		}
+		static void operator delete(void *p, size_t size)
+		{
+			FramePool::deallocate(p, size);
+		}
+	};
+	using Handle = std::coroutine_handle<promise_type>;
+
+	explicit Behaviour(Handle handle) : handle(handle) {}
+	Behaviour(Behaviour &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Behaviour(const Behaviour &) = delete;
+	Behaviour &operator=(const Behaviour &) = delete;
+	~Behaviour()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	Handle release()
+	{
+		return std::exchange(handle, nullptr);
+	}
+private:
+	Handle handle;
+};
+
+enum class BehaviourEvent
+{
+	none, grounded
+};
+
+// behaviours waiting on an object, whoever raises an event passes it to wake()
+struct BehaviourWait
+{
+	struct Waiter
+	{
+		BehaviourEvent event;
+		std::coroutine_handle<> handle;
+	};
+	std::vector<Waiter> waiters;
+};
+
+// owns all running behaviours and resumes only the ones whose wait has finished
+class BehaviourScheduler
+{
+public:
+	BehaviourScheduler(TimerWheel &timers) : timers(timers), resumed(0) {}
+	BehaviourScheduler(const BehaviourScheduler &) = delete;
+	BehaviourScheduler &operator=(const BehaviourScheduler &) = delete;
+	~BehaviourScheduler()
+	{
+		clear();
+	}
+
+	// the behaviour first runs on the next run()
+	void spawn(Behaviour behaviour)
+	{
+		Behaviour::Handle handle = behaviour.release();
+		handle.promise().scheduler = this;
+		live.push_back(handle);
+		ready.push_back(handle);
+	}
+
+	void sleep(Behaviour::Handle handle, float seconds)
+	{
+		handle.promise().sleepTimer = timers.schedule(seconds, [this, handle]()
+			{
+				handle.promise().sleepTimer = NO_TIMER;
+				ready.push_back(handle);
+			});
+	}
+
+	// resumes everything on the object waiting for this event
+	void wake(BehaviourWait &wait, BehaviourEvent event)
+	{
+		std::erase_if(wait.waiters, [this, event](const BehaviourWait::Waiter &waiter)
+			{
+				if (waiter.event != event)
+				{
+					return false;
+				}
+				ready.push_back(waiter.handle);
+				return true;
+			});
+	}
+
+	// call once per simulation tick after advancing the timer wheel
+	void run()
+	{
+		// anything made ready while these run waits for the next tick
+		running.swap(ready);
+		resumed = static_cast<int>(running.size());
+		for (std::coroutine_handle<> handle : running)
+		{
+			handle.resume();
+			if (handle.done())
+			{
+				handle.destroy();
+				live.erase(std::find_if(live.begin(), live.end(),
+					[handle](Behaviour::Handle h) { return h.address() == handle.address(); }));
+			}
+		}
+		running.clear();
+	}
+
+	// destroys every behaviour, waits that objects still hold become invalid
+	void clear()
+	{
+		for (Behaviour::Handle handle : live)
+		{
+			timers.cancel(handle.promise().sleepTimer);
+			handle.destroy();
+		}
+		live.clear();
+		ready.clear();
+	}
+
+	int getLiveCount() const
+	{
+		return static_cast<int>(live.size());
+	}
+	int getResumedCount() const
+	{
+		return resumed;
+	}
+private:
+	TimerWheel &timers;	// sleeps are scheduled here
+	int resumed;	// behaviours resumed by the last run()
+	std::vector<Behaviour::Handle> live;
+	std::vector<std::coroutine_handle<>> ready, running;
+};
+
+struct WaitSeconds
+{
+	float seconds;
+
+	bool await_ready() const
+	{
+		return seconds <= 0;
+	}
+	void await_suspend(Behaviour::Handle handle) const
+	{
+		handle.promise().scheduler->sleep(handle, seconds);
+	}
+	void await_resume() const {}
+};
+
+// suspends until wake() raises the event on the object, unless the condition already holds
+struct WaitEvent
+{
+	BehaviourWait &wait;
+	BehaviourEvent event;
+	bool ready;
+
+	bool await_ready() const
+	{
+		return ready;
+	}
+	void await_suspend(Behaviour::Handle handle) const
+	{
+		wait.waiters.push_back({ .event = event, .handle = handle });
+	}
+	void await_resume() const {}
+};
\ No newline at end of file
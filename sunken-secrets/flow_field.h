@@ -0,0 +1,219 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+// grid of steering directions that all lead towards a single target cell
+class FlowField
+{
+public:
+	static constexpr uint16_t UNREACHABLE = 0xFFFF;
+
+	FlowField() : rows(0), cols(0), cellSize(0), origin(0), targetRow(-1), targetCol(-1),
+		requestedRow(-1), requestedCol(-1), phase(Phase::idle), head(0), directionRow(0) {}
+
+	void build(int rows, int cols, float cellSize, glm::vec2 origin, const std::vector<uint8_t> &blocked)
+	{
+		this->rows = rows;
+		this->cols = cols;
+		this->cellSize = cellSize;
+		this->origin = origin;
+		this->blocked = blocked;
+		integration.assign(rows * cols, UNREACHABLE);
+		directions.assign(rows * cols, glm::vec2(0));
+		pendingDirections.assign(rows * cols, glm::vec2(0));
+		queue.reserve(rows * cols);
+		targetRow = targetCol = -1;
+		requestedRow = requestedCol = -1;
+		phase = Phase::idle;
+	}
+
+	// moves the target, the field is then recomputed over calls to rebuild() while
+	// getDirection() keeps using the last finished one. returns true when a rebuild
+	// was started, a target change during a rebuild is picked up once it finishes
+	bool setTarget(glm::vec2 position)
+	{
+		int row, col;
+		if (!cellAt(position, row, col))
+		{
+			return false;
+		}
+		// a target inside a blocked cell is moved down to the first open cell below it
+		while (row < rows && blocked[index(row, col)])
+		{
+			row++;
+		}
+		if (row == rows || (row == requestedRow && col == requestedCol))
+		{
+			return false;
+		}
+		requestedRow = row;
+		requestedCol = col;
+		if (phase != Phase::idle)
+		{
+			return false;
+		}
+		startRebuild();
+		return true;
+	}
+
+	// advances the rebuild by roughly maxCells cells of work, returns true once nothing is left
+	bool rebuild(int maxCells)
+	{
+		int work = 0;
+		while (phase != Phase::idle && work < maxCells)
+		{
+			if (phase == Phase::integrating)
+			{
+				work += integrate(maxCells - work);
+			}
+			else
+			{
+				work += computeDirections(maxCells - work);
+			}
+			if (phase == Phase::idle)
+			{
+				directions.swap(pendingDirections);
+				if (requestedRow != targetRow || requestedCol != targetCol)
+				{
+					startRebuild();
+				}
+			}
+		}
+		return phase == Phase::idle;
+	}
+
+	// normalized direction to steer in, zero inside the target cell and in blocked cells
+	glm::vec2 getDirection(glm::vec2 position) const
+	{
+		int row, col;
+		if (!cellAt(position, row, col))
+		{
+			return glm::vec2(0);
+		}
+		return directions[index(row, col)];
+	}
+private:
+	int index(int row, int col) const
+	{
+		return row * cols + col;
+	}
+	bool cellAt(glm::vec2 position, int &row, int &col) const
+	{
+		row = static_cast<int>(std::floor((position.y - origin.y) / cellSize));
+		col = static_cast<int>(std::floor((position.x - origin.x) / cellSize));
+		return row >= 0 && row < rows && col >= 0 && col < cols;
+	}
+	bool isOpen(int row, int col) const
+	{
+		return row >= 0 && row < rows && col >= 0 && col < cols && !blocked[index(row, col)];
+	}
+
+	void startRebuild()
+	{
+		targetRow = requestedRow;
+		targetCol = requestedCol;
+		std::fill(integration.begin(), integration.end(), UNREACHABLE);
+		queue.clear();
+		integration[index(targetRow, targetCol)] = 0;
+		queue.push_back(index(targetRow, targetCol));
+		head = 0;
+		directionRow = 0;
+		phase = Phase::integrating;
+	}
+
+	// breadth first search outwards from the target, every step costs 1,
+	// processes up to maxCells cells and returns how many it did
+	int integrate(int maxCells)
+	{
+		int done = 0;
+		for (; head < queue.size() && done < maxCells; head++, done++)
+		{
+			const int cell = queue[head];
+			const int row = cell / cols;
+			const int col = cell % cols;
+			const uint16_t cost = integration[cell] + 1;
+			for (int n = 0; n < 4; n++)
+			{
+				const int r = row + NEIGHBOURS[n][0];
+				const int c = col + NEIGHBOURS[n][1];
+				if (isOpen(r, c) && integration[index(r, c)] == UNREACHABLE)
+				{
+					integration[index(r, c)] = cost;
+					queue.push_back(index(r, c));
+				}
+			}
+		}
+		if (head == queue.size())
+		{
+			phase = Phase::directing;
+		}
+		return done;
+	}
+
+	// point every cell at its cheapest neighbour, diagonals may not cut corners,
+	// works in whole rows and returns how many cells it did
+	int computeDirections(int maxCells)
+	{
+		int done = 0;
+		for (; directionRow < rows && done < maxCells; directionRow++, done += cols)
+		{
+			const int row = directionRow;
+			for (int col = 0; col < cols; col++)
+			{
+				glm::vec2 &dir = pendingDirections[index(row, col)];
+				dir = glm::vec2(0);
+				uint16_t best = integration[index(row, col)];
+				if (best == UNREACHABLE || best == 0)
+				{
+					continue;
+				}
+				for (int n = 0; n < 8; n++)
+				{
+					const int dr = NEIGHBOURS[n][0];
+					const int dc = NEIGHBOURS[n][1];
+					if (!isOpen(row + dr, col + dc) || integration[index(row + dr, col + dc)] >= best)
+					{
+						continue;
+					}
+					if (dr && dc && (!isOpen(row + dr, col) || !isOpen(row, col + dc)))
+					{
+						continue;
+					}
+					best = integration[index(row + dr, col + dc)];
+					dir = glm::normalize(glm::vec2(static_cast<float>(dc), static_cast<float>(dr)));
+				}
+			}
+		}
+		if (directionRow == rows)
+		{
+			phase = Phase::idle;
+		}
+		return done;
+	}
+
+	// orthogonal neighbours first so they win ties
+	static constexpr int NEIGHBOURS[8][2] = {
+		{ -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+		{ -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 }
+	};
+
+	enum class Phase
+	{
+		idle, integrating, directing
+	};
+
+	int rows, cols;
+	float cellSize;
+	glm::vec2 origin;
+	int targetRow, targetCol;		// target of the rebuild in progress or the last one
+	int requestedRow, requestedCol;	// latest target passed to setTarget()
+	Phase phase;
+	size_t head;		// next queue entry to expand while integrating
+	int directionRow;	// next row to compute while directing
+	std::vector<uint8_t> blocked;
+	std::vector<uint16_t> integration;
+	std::vector<glm::vec2> directions, pendingDirections;
+	std::vector<int> queue;
+};
\ No newline at end of file
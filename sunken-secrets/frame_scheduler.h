@@ -0,0 +1,73 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// runs deferrable work in slices, only as much as fits before the frame deadline
+class FrameScheduler
+{
+public:
+	FrameScheduler() : budgetMs(0), usedMs(0), slices(0) {}
+
+	// step does one slice of work and returns true once the task is finished,
+	// higher priorities run first and equal priorities in submission order
+	void submit(int priority, std::function<bool()> step)
+	{
+		const auto at = std::upper_bound(tasks.begin(), tasks.end(), priority,
+			[](int p, const Task &task) { return p > task.priority; });
+		tasks.insert(at, Task{ .priority = priority, .step = std::move(step) });
+	}
+
+	// deadline is in SDL_GetTicksNS time, at least one slice runs so work never stalls completely
+	void run(Uint64 deadline)
+	{
+		const Uint64 start = SDL_GetTicksNS();
+		budgetMs = deadline > start ? (deadline - start) / static_cast<float>(SDL_NS_PER_MS) : 0.0f;
+		slices = 0;
+		Uint64 now = start;
+		while (!tasks.empty() && (now < deadline || slices == 0))
+		{
+			// step() may submit more tasks, so the task is taken out of the list while it runs
+			// and an unfinished one goes back in ahead of everything else of its priority
+			Task task = std::move(tasks.front());
+			tasks.erase(tasks.begin());
+			if (!task.step())
+			{
+				const auto at = std::lower_bound(tasks.begin(), tasks.end(), task.priority,
+					[](const Task &other, int p) { return other.priority > p; });
+				tasks.insert(at, std::move(task));
+			}
+			slices++;
+			now = SDL_GetTicksNS();
+		}
+		usedMs = (now - start) / static_cast<float>(SDL_NS_PER_MS);
+	}
+
+	float getBudgetMs() const
+	{
+		return budgetMs;
+	}
+	float getUsedMs() const
+	{
+		return usedMs;
+	}
+	int getSlices() const
+	{
+		return slices;
+	}
+	int getBacklog() const
+	{
+		return static_cast<int>(tasks.size());
+	}
+private:
+	struct Task
+	{
+		int priority;
+		std::function<bool()> step;
+	};
+
+	std::vector<Task> tasks;	// highest priority first
+	float budgetMs, usedMs;		// of the last run()
+	int slices;
+};
\ No newline at end of file
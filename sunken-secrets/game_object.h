@@ -3,6 +3,9 @@
 #include "vector"
 #include <SDL3/SDL.h>
 #include "animation.h"
+#include "world_pos.h"
+#include "texture_residency.h"
+#include "behaviour.h"
 
 enum class PlayerState
 {
@@ -14,12 +17,18 @@ enum class SpearState
 	moving, colliding, inactive
 };
 
+enum class EnemyState
+{
+	chasing, slowing, resting
+};
+
 struct PlayerData
 {
 	PlayerState state;
 	Timer weaponTimer;	
+	Timer bubbleTimer;
 
-	PlayerData() : weaponTimer(0.2f)	// fire rate 0.2 seconds
+	PlayerData() : weaponTimer(0.2f), bubbleTimer(0.6f)	// fire rate 0.2 seconds, breathe every 0.6 seconds
 	{
 		state = PlayerState::idle;
 	}
@@ -32,7 +41,11 @@ struct LevelData
 
 struct EnemyData
 {
-
+	EnemyState state;
+	double phaseEnd;	// simulation time the current state ends, starts at the end of a rest
+	EnemyData() : state(EnemyState::resting), phaseEnd(0)
+	{
+	}
 };
 
 struct SpearData
@@ -55,30 +68,64 @@ enum class ObjectType
 	player, level, enemy, spear
 };
 
+// one collision category bit per object type
+inline uint32_t collisionCategory(ObjectType type)
+{
+	return 1u << static_cast<int>(type);
+}
+
+// categories each object type responds to, indexed by ObjectType
+const uint32_t COLLISION_MASKS[] = {
+	1u << static_cast<int>(ObjectType::level),	// player
+	0,											// level
+	0,											// enemy
+	(1u << static_cast<int>(ObjectType::level)) | (1u << static_cast<int>(ObjectType::enemy))	// spear
+};
+
+inline uint32_t collisionMask(ObjectType type)
+{
+	return COLLISION_MASKS[static_cast<int>(type)];
+}
+
 struct GameObject
 {
 	ObjectType type;
 	ObjectData data;
-	glm::vec2 position, velocity, acceleration;
+	WorldPos position;
+	glm::vec2 velocity, acceleration;
 	float direction;
 	float maxSpeedX;
 	std::vector<Animation> animations;
 	int currentAnimation;
-	SDL_Texture *texture;
+	TextureId texture;
 	bool dynamic;
 	bool grounded;
 	SDL_FRect collider;
+	float lagTime;	// simulation time not yet applied, see updateObjects()
+	BehaviourWait wait;
 
 	GameObject() : data{.level = LevelData()}, collider{ 0 }
 	{
 		type = ObjectType::level;
 		direction = 1;
 		maxSpeedX = 0;
-		position = velocity = acceleration = glm::vec2(0);
+		velocity = acceleration = glm::vec2(0);
 		currentAnimation = -1;
-		texture = nullptr;
+		texture = NO_TEXTURE;
 		dynamic = false;
 		grounded = false;
+		lagTime = 0;
 	}
 
-};
\ No newline at end of file
+};
+
+// awaitables for behaviours, grounded is raised from update()
+inline WaitEvent waitUntilGrounded(GameObject &obj)
+{
+	return WaitEvent{ .wait = obj.wait, .event = BehaviourEvent::grounded, .ready = obj.grounded };
+}
+inline WaitSeconds waitAnimationDone(const GameObject &obj, double now)
+{
+	const Animation &anim = obj.animations[obj.currentAnimation];
+	return WaitSeconds{ .seconds = anim.isDone(now) ? 0.0f : anim.getLength() - anim.getTimer().getTime(now) };
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+#include <SDL3/SDL.h>
+
+// the input events the simulation cares about, stamped when SDL received them
+struct InputEvent
+{
+	Uint64 timestamp;	// nanoseconds, same clock as SDL_GetTicksNS
+	Uint32 type;
+	SDL_Scancode scancode;
+	Uint8 button;
+	bool repeat;
+};
\ No newline at end of file
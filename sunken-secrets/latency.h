@@ -0,0 +1,106 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <vector>
+#include <algorithm>
+
+struct LatencyStats
+{
+	float p50, p95, p99;	// milliseconds
+	int samples;
+
+	LatencyStats() : p50(0), p95(0), p99(0), samples(0) {}
+};
+
+// follows input events from their SDL timestamp through the tick that consumes them
+// to the frame that presents the result
+class LatencyTracker
+{
+public:
+	static constexpr int MAX_SAMPLES = 1024;
+
+	LatencyTracker() : nextSample(0), sampleCount(0), lastRefresh(0)
+	{
+		tickSamples.resize(MAX_SAMPLES);
+		presentSamples.resize(MAX_SAMPLES);
+	}
+
+	// timestamp uses the SDL_GetTicksNS clock, like SDL_Event::common.timestamp
+	void inputReceived(Uint64 timestamp)
+	{
+		pending.push_back(PendingInput{ .input = timestamp, .tick = 0 });
+	}
+	void tickConsumed(Uint64 tickTime)
+	{
+		for (PendingInput &p : pending)
+		{
+			p.tick = tickTime;
+			consumed.push_back(p);
+		}
+		pending.clear();
+	}
+	void framePresented(Uint64 presentTime)
+	{
+		for (const PendingInput &p : consumed)
+		{
+			tickSamples[nextSample] = toMs(p.tick - std::min(p.input, p.tick));
+			presentSamples[nextSample] = toMs(presentTime - std::min(p.input, presentTime));
+			nextSample = (nextSample + 1) % MAX_SAMPLES;
+			sampleCount = std::min(sampleCount + 1, MAX_SAMPLES);
+		}
+		consumed.clear();
+	}
+
+	// recomputes the percentiles at most once per interval, returns true if it did
+	bool refresh(Uint64 now, Uint64 interval)
+	{
+		if (now - lastRefresh < interval)
+		{
+			return false;
+		}
+		lastRefresh = now;
+		tickStats = computeStats(tickSamples);
+		presentStats = computeStats(presentSamples);
+		return true;
+	}
+	const LatencyStats &getTickStats() const
+	{
+		return tickStats;
+	}
+	const LatencyStats &getPresentStats() const
+	{
+		return presentStats;
+	}
+private:
+	struct PendingInput
+	{
+		Uint64 input;
+		Uint64 tick;
+	};
+
+	static float toMs(Uint64 ns)
+	{
+		return static_cast<float>(ns) / SDL_NS_PER_MS;
+	}
+	LatencyStats computeStats(const std::vector<float> &samples)
+	{
+		LatencyStats stats;
+		stats.samples = sampleCount;
+		if (!sampleCount)
+		{
+			return stats;
+		}
+		sorted.assign(samples.begin(), samples.begin() + sampleCount);
+		std::sort(sorted.begin(), sorted.end());
+		const auto at = [this](float p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+		stats.p50 = at(0.50f);
+		stats.p95 = at(0.95f);
+		stats.p99 = at(0.99f);
+		return stats;
+	}
+
+	std::vector<PendingInput> pending, consumed;
+	std::vector<float> tickSamples, presentSamples, sorted;
+	int nextSample, sampleCount;
+	Uint64 lastRefresh;
+	LatencyStats tickStats, presentStats;
+};
\ No newline at end of file
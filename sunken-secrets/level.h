@@ -0,0 +1,224 @@
+#pragma once
+#include <array>
+#include <string_view>
+#include <cstdint>
+#include "level_data.h"
+
+enum TileCode : uint8_t
+{
+	TILE_EMPTY = 0,
+	TILE_PLAYER = 1,
+	TILE_BOAT = 2,
+	TILE_SURFACE = 3,
+	TILE_SHALLOW_WATER = 4,
+	TILE_MEDIUM_WATER = 5,
+	TILE_DEEP_WATER = 6,
+	TILE_ROCK = 7,
+	TILE_TREASURE = 8,
+	TILE_FISH = 9,
+	TILE_CODE_COUNT,
+	TILE_INVALID = 0xFF
+};
+
+struct LevelTile
+{
+	uint16_t row, col;
+	uint8_t code;
+};
+
+// sizes of a level, known before it is compiled so the output can be fixed size arrays
+struct LevelInfo
+{
+	int rows, cols;
+	int tileCount, backgroundCount, fishCount;
+	int playerCount;
+	int waterRow;	// first row holding the water surface, -1 if there is none
+};
+
+// deliberately not constexpr: reaching it while compiling a level stops the build,
+// and the compiler error points at the call with the message
+inline void levelError([[maybe_unused]] const char *message) {}
+
+constexpr uint8_t mapTileCode(char c)
+{
+	switch (c)
+	{
+		case '.': return TILE_EMPTY;
+		case 'P': return TILE_PLAYER;
+		case 'B': return TILE_BOAT;
+		case '#': return TILE_ROCK;
+		case 'T': return TILE_TREASURE;
+		case 'F': return TILE_FISH;
+	}
+	return TILE_INVALID;
+}
+
+constexpr uint8_t backgroundTileCode(char c)
+{
+	switch (c)
+	{
+		case '.': return TILE_EMPTY;
+		case '~': return TILE_SURFACE;
+		case 's': return TILE_SHALLOW_WATER;
+		case 'm': return TILE_MEDIUM_WATER;
+		case 'd': return TILE_DEEP_WATER;
+	}
+	return TILE_INVALID;
+}
+
+// validates the level text and calls visit(layer, row, col, code) for every non-empty cell
+template <typename Visitor>
+constexpr LevelInfo parseLevel(std::string_view source, Visitor &&visit)
+{
+	LevelInfo info{ .rows = 0, .cols = 0, .tileCount = 0, .backgroundCount = 0,
+		.fishCount = 0, .playerCount = 0, .waterRow = -1 };
+	int layer = 0;
+	int row = 0;
+
+	const auto finishLayer = [&]()
+	{
+		if (layer == 0)
+		{
+			info.rows = row;
+		}
+		else if (row != info.rows)
+		{
+			levelError("the background layer must have as many rows as the map layer");
+		}
+		layer++;
+		row = 0;
+	};
+
+	size_t pos = 0;
+	while (pos < source.size())
+	{
+		size_t end = source.find('\n', pos);
+		if (end == std::string_view::npos)
+		{
+			end = source.size();
+		}
+		std::string_view line = source.substr(pos, end - pos);
+		pos = end + 1;
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+		if (!line.empty() && line.front() == ';')	// comment
+		{
+			continue;
+		}
+		if (line.empty())
+		{
+			if (row > 0)
+			{
+				finishLayer();
+			}
+			continue;
+		}
+		if (layer > 1)
+		{
+			levelError("a level has exactly two layers, map and background");
+		}
+		if (info.cols == 0)
+		{
+			info.cols = static_cast<int>(line.size());
+		}
+		else if (static_cast<int>(line.size()) != info.cols)
+		{
+			levelError("all rows of a level must be the same width");
+		}
+
+		for (int col = 0; col < info.cols; col++)
+		{
+			const uint8_t code = layer == 0 ? mapTileCode(line[col]) : backgroundTileCode(line[col]);
+			if (code == TILE_INVALID)
+			{
+				levelError("unknown tile character for this layer");
+			}
+			if (code == TILE_EMPTY)
+			{
+				continue;
+			}
+			if (layer == 0)
+			{
+				info.playerCount += code == TILE_PLAYER;
+				info.fishCount += code == TILE_FISH;
+				info.tileCount += code != TILE_PLAYER && code != TILE_FISH;
+			}
+			else
+			{
+				info.backgroundCount++;
+				if (code == TILE_SURFACE && info.waterRow == -1)
+				{
+					info.waterRow = row;
+				}
+			}
+			visit(layer, row, col, code);
+		}
+		row++;
+	}
+	if (row > 0)
+	{
+		finishLayer();
+	}
+
+	if (layer != 2)
+	{
+		levelError("a level needs a map layer and a background layer separated by a blank line");
+	}
+	if (info.playerCount != 1)
+	{
+		levelError("a level needs exactly one player");
+	}
+	return info;
+}
+
+constexpr LevelInfo measureLevel(std::string_view source)
+{
+	return parseLevel(source, [](int, int, int, uint8_t) {});
+}
+
+template <LevelInfo Info>
+struct CompiledLevel
+{
+	static constexpr int rows = Info.rows;
+	static constexpr int cols = Info.cols;
+	static constexpr int waterRow = Info.waterRow;
+	std::array<uint8_t, Info.rows * Info.cols> grid;	// solid map tiles, spawns are left empty
+	std::array<LevelTile, Info.tileCount> tiles;
+	std::array<LevelTile, Info.backgroundCount> background;
+	std::array<LevelTile, Info.fishCount> fish;
+	LevelTile player;
+};
+
+template <LevelInfo Info>
+constexpr CompiledLevel<Info> compileLevel(std::string_view source)
+{
+	CompiledLevel<Info> level{};
+	int tile = 0, background = 0, fish = 0;
+	parseLevel(source, [&](int layer, int row, int col, uint8_t code)
+	{
+		const LevelTile t{ .row = static_cast<uint16_t>(row), .col = static_cast<uint16_t>(col), .code = code };
+		if (layer == 1)
+		{
+			level.background[background++] = t;
+		}
+		else if (code == TILE_PLAYER)
+		{
+			level.player = t;
+		}
+		else if (code == TILE_FISH)
+		{
+			level.fish[fish++] = t;
+		}
+		else
+		{
+			level.grid[row * Info.cols + col] = code;
+			level.tiles[tile++] = t;
+		}
+	});
+	return level;
+}
+
+constexpr LevelInfo LEVEL_1_INFO = measureLevel(LEVEL_1_SOURCE);
+constexpr auto LEVEL_1 = compileLevel<LEVEL_1_INFO>(LEVEL_1_SOURCE);
\ No newline at end of file
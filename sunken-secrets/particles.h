@@ -0,0 +1,187 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <SDL3/SDL.h>
+#include <vector>
+#include <algorithm>
+
+const int MAX_PARTICLES = 65536;
+
+// describes a burst of particles, the spread values are random +/- ranges
+struct ParticleEmitter
+{
+	glm::vec2 velocity;
+	glm::vec2 velocitySpread;
+	glm::vec2 positionSpread;
+	float buoyancy;		// upward acceleration, negative values sink
+	float drag;			// fraction of velocity lost per second
+	float life;
+	float lifeSpread;
+	float size;
+	SDL_FColor color;
+
+	ParticleEmitter() : velocity(0), velocitySpread(0), positionSpread(0), color{ 1, 1, 1, 1 }
+	{
+		buoyancy = 0;
+		drag = 0;
+		life = 1;
+		lifeSpread = 0;
+		size = 1;
+	}
+};
+
+class ParticleSystem
+{
+public:
+	ParticleSystem() : count(0)
+	{
+		// the hot simulation data is kept in separate arrays so update() vectorizes
+		posX.resize(MAX_PARTICLES);
+		posY.resize(MAX_PARTICLES);
+		velX.resize(MAX_PARTICLES);
+		velY.resize(MAX_PARTICLES);
+		buoyancy.resize(MAX_PARTICLES);
+		drag.resize(MAX_PARTICLES);
+		life.resize(MAX_PARTICLES);
+		invMaxLife.resize(MAX_PARTICLES);
+		size.resize(MAX_PARTICLES);
+		color.resize(MAX_PARTICLES);
+
+		// every particle is a quad, so the index buffer never changes
+		indices.resize(MAX_PARTICLES * 6);
+		for (int i = 0; i < MAX_PARTICLES; i++)
+		{
+			const int v = i * 4;
+			int *idx = &indices[i * 6];
+			idx[0] = v; idx[1] = v + 1; idx[2] = v + 2;
+			idx[3] = v + 2; idx[4] = v + 3; idx[5] = v;
+		}
+		// sized once for the worst case, draw() writes into it without growing it
+		vertices.resize(MAX_PARTICLES * 4);
+	}
+
+	void emit(const ParticleEmitter &emitter, glm::vec2 position, int amount)
+	{
+		const auto spread = []() { return SDL_randf() * 2.0f - 1.0f; };
+
+		for (int n = 0; n < amount && count < MAX_PARTICLES; n++)
+		{
+			const int i = count++;
+			posX[i] = position.x + emitter.positionSpread.x * spread();
+			posY[i] = position.y + emitter.positionSpread.y * spread();
+			velX[i] = emitter.velocity.x + emitter.velocitySpread.x * spread();
+			velY[i] = emitter.velocity.y + emitter.velocitySpread.y * spread();
+			buoyancy[i] = emitter.buoyancy;
+			drag[i] = emitter.drag;
+			life[i] = std::max(emitter.life + emitter.lifeSpread * spread(), 0.01f);
+			invMaxLife[i] = 1.0f / life[i];
+			size[i] = emitter.size;
+			color[i] = emitter.color;
+		}
+	}
+
+	void update(float deltaTime, float waterLevel)
+	{
+		// integrate, no branches so the compiler can use SIMD
+		// particles rising through the surface from below expire, ones above it (silt kicked up
+		// out of the water) live out their lifetime
+		float *px = posX.data(), *py = posY.data();
+		float *vx = velX.data(), *vy = velY.data();
+		const float *b = buoyancy.data(), *d = drag.data();
+		float *l = life.data();
+		for (int i = 0; i < count; i++)
+		{
+			const float damping = std::max(1.0f - d[i] * deltaTime, 0.0f);
+			const float y = py[i];
+			vx[i] *= damping;
+			vy[i] = (vy[i] - b[i] * deltaTime) * damping;
+			px[i] += vx[i] * deltaTime;
+			py[i] = y + vy[i] * deltaTime;
+			const bool surfaced = (y >= waterLevel) & (py[i] < waterLevel);
+			l[i] = (l[i] - deltaTime) * static_cast<float>(!surfaced);
+		}
+
+		// remove expired particles
+		int i = 0;
+		while (i < count)
+		{
+			if (l[i] <= 0)
+			{
+				moveParticle(--count, i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	// returns the number of draw calls made
+	int draw(SDL_Renderer *renderer, const SDL_FRect &viewport)
+	{
+		int quads = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const float s = size[i];
+			const float x = posX[i] - viewport.x;
+			const float y = posY[i] - viewport.y;
+			if (x + s < 0 || x > viewport.w || y + s < 0 || y > viewport.h)
+			{
+				continue;
+			}
+			SDL_FColor c = color[i];
+			c.a *= life[i] * invMaxLife[i];	// fade out over lifetime
+			SDL_Vertex *v = &vertices[quads++ * 4];
+			v[0] = SDL_Vertex{ .position = { x, y }, .color = c, .tex_coord = { 0, 0 } };
+			v[1] = SDL_Vertex{ .position = { x + s, y }, .color = c, .tex_coord = { 0, 0 } };
+			v[2] = SDL_Vertex{ .position = { x + s, y + s }, .color = c, .tex_coord = { 0, 0 } };
+			v[3] = SDL_Vertex{ .position = { x, y + s }, .color = c, .tex_coord = { 0, 0 } };
+		}
+
+		if (!quads)
+		{
+			return 0;
+		}
+		SDL_RenderGeometry(renderer, nullptr, vertices.data(), quads * 4, indices.data(), quads * 6);
+		return 1;
+	}
+
+	// moves every particle, used when the particle space is rebased to a new origin
+	void shift(glm::vec2 offset)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			posX[i] += offset.x;
+			posY[i] += offset.y;
+		}
+	}
+
+	int getCount() const
+	{
+		return count;
+	}
+	void clear()
+	{
+		count = 0;
+	}
+private:
+	void moveParticle(int from, int to)
+	{
+		posX[to] = posX[from];
+		posY[to] = posY[from];
+		velX[to] = velX[from];
+		velY[to] = velY[from];
+		buoyancy[to] = buoyancy[from];
+		drag[to] = drag[from];
+		life[to] = life[from];
+		invMaxLife[to] = invMaxLife[from];
+		size[to] = size[from];
+		color[to] = color[from];
+	}
+
+	int count;
+	std::vector<float> posX, posY, velX, velY;
+	std::vector<float> buoyancy, drag, life, invMaxLife, size;
+	std::vector<SDL_FColor> color;
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <string>
+#include <vector>
+
+struct ProfileSection
+{
+	std::string name;
+	float ms;			// last measured time
+	float averageMs;	// smoothed time for display
+	Uint64 start;
+
+	ProfileSection(const std::string &name) : name(name), ms(0), averageMs(0), start(0) {}
+};
+
+class Profiler
+{
+public:
+	Profiler() : frequency(SDL_GetPerformanceFrequency()) {}
+
+	int addSection(const std::string &name)
+	{
+		sections.emplace_back(name);
+		return static_cast<int>(sections.size()) - 1;
+	}
+	void begin(int id)
+	{
+		sections[id].start = SDL_GetPerformanceCounter();
+	}
+	void end(int id)
+	{
+		clear(id);
+		add(id);
+		finish(id);
+	}
+
+	// for sections timed in several pieces per frame: clear() once, time each piece
+	// with begin() and add(), then finish() once all pieces for the frame are in
+	void clear(int id)
+	{
+		sections[id].ms = 0;
+	}
+	void add(int id)
+	{
+		ProfileSection &section = sections[id];
+		section.ms += (SDL_GetPerformanceCounter() - section.start) * 1000.0f / frequency;
+	}
+	void finish(int id)
+	{
+		ProfileSection &section = sections[id];
+		section.averageMs += (section.ms - section.averageMs) * 0.05f;
+	}
+	const std::vector<ProfileSection> &getSections() const
+	{
+		return sections;
+	}
+private:
+	std::vector<ProfileSection> sections;
+	Uint64 frequency;
+};
+
+// times the enclosing scope into a profiler section, with accumulate the time is
+// added to the section instead of replacing it (see Profiler::clear)
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler &profiler, int id, bool accumulate = false) : profiler(profiler), id(id), accumulate(accumulate)
+	{
+		profiler.begin(id);
+	}
+	~ProfileScope()
+	{
+		if (accumulate)
+		{
+			profiler.add(id);
+		}
+		else
+		{
+			profiler.end(id);
+		}
+	}
+private:
+	Profiler &profiler;
+	int id;
+	bool accumulate;
+};
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// appends plain values to a flat byte blob
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(std::vector<uint8_t> &out) : out(out)
+	{
+		out.clear();
+	}
+
+	template <typename T>
+	void write(const T &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "snapshots only hold plain data");
+		const size_t at = out.size();
+		out.resize(at + sizeof(T));
+		std::memcpy(out.data() + at, &value, sizeof(T));
+	}
+private:
+	std::vector<uint8_t> &out;
+};
+
+class SnapshotReader
+{
+public:
+	SnapshotReader(const std::vector<uint8_t> &in) : in(in), pos(0) {}
+
+	template <typename T>
+	bool read(T &value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "snapshots only hold plain data");
+		if (pos + sizeof(T) > in.size())
+		{
+			return false;
+		}
+		std::memcpy(&value, in.data() + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+private:
+	const std::vector<uint8_t> &in;
+	size_t pos;
+};
+
+// history of snapshots, stored as run length encoded XOR deltas against the last keyframe
+class RewindBuffer
+{
+public:
+	RewindBuffer(size_t byteBudget, int keyframeInterval)
+		: byteBudget(byteBudget), keyframeInterval(keyframeInterval), bytesUsed(0),
+		nextSequence(0), cachedKeyframe(UINT64_MAX), forceKeyframe(false) {}
+
+	void push(const std::vector<uint8_t> &snapshot)
+	{
+		Entry entry;
+		entry.sequence = nextSequence++;
+		entry.size = snapshot.size();
+		entry.keyframe = frames.empty() || forceKeyframe || static_cast<int>(frames.size() - lastKeyframe()) >= keyframeInterval;
+		if (!entry.keyframe)
+		{
+			entry.keyframe = !loadKeyframe(lastKeyframe()) || keyframe.size() != snapshot.size();
+		}
+		if (entry.keyframe)
+		{
+			keyframe = snapshot;
+			cachedKeyframe = entry.sequence;
+			forceKeyframe = false;
+			encode(snapshot, entry.data);
+		}
+		else
+		{
+			scratch.resize(snapshot.size());
+			for (size_t i = 0; i < snapshot.size(); i++)
+			{
+				scratch[i] = snapshot[i] ^ keyframe[i];
+			}
+			encode(scratch, entry.data);
+		}
+		bytesUsed += entry.data.size();
+		frames.push_back(std::move(entry));
+
+		// drop the oldest keyframe and its deltas together so nothing refers to a missing keyframe,
+		// the newest keyframe's group is never dropped, instead the next push starts a new one
+		while (bytesUsed > byteBudget)
+		{
+			size_t groupEnd = 1;
+			while (groupEnd < frames.size() && !frames[groupEnd].keyframe)
+			{
+				groupEnd++;
+			}
+			if (groupEnd == frames.size())
+			{
+				forceKeyframe = true;
+				break;
+			}
+			for (size_t i = 0; i < groupEnd; i++)
+			{
+				bytesUsed -= frames.front().data.size();
+				frames.pop_front();
+			}
+		}
+	}
+
+	// removes the most recent snapshot and writes it to out, returns false when empty,
+	// history that fails to decode is thrown away
+	bool pop(std::vector<uint8_t> &out)
+	{
+		if (frames.empty())
+		{
+			return false;
+		}
+		if (!loadKeyframe(lastKeyframe()))
+		{
+			clear();
+			return false;
+		}
+
+		const Entry &entry = frames.back();
+		if (entry.keyframe)
+		{
+			out = keyframe;
+		}
+		else
+		{
+			if (!decode(entry.data, out, entry.size))
+			{
+				clear();
+				return false;
+			}
+			for (size_t i = 0; i < out.size(); i++)
+			{
+				out[i] ^= keyframe[i];
+			}
+		}
+		bytesUsed -= entry.data.size();
+		frames.pop_back();
+		return true;
+	}
+
+	void clear()
+	{
+		frames.clear();
+		bytesUsed = 0;
+		cachedKeyframe = UINT64_MAX;
+		forceKeyframe = false;
+	}
+	size_t getFrameCount() const
+	{
+		return frames.size();
+	}
+	size_t getBytesUsed() const
+	{
+		return bytesUsed;
+	}
+private:
+	struct Entry
+	{
+		uint64_t sequence;
+		size_t size;
+		bool keyframe;
+		std::vector<uint8_t> data;
+	};
+
+	size_t lastKeyframe() const
+	{
+		size_t k = frames.size() - 1;
+		while (!frames[k].keyframe)
+		{
+			k--;
+		}
+		return k;
+	}
+	bool loadKeyframe(size_t k)
+	{
+		if (cachedKeyframe != frames[k].sequence)
+		{
+			if (!decode(frames[k].data, keyframe, frames[k].size))
+			{
+				cachedKeyframe = UINT64_MAX;
+				return false;
+			}
+			cachedKeyframe = frames[k].sequence;
+		}
+		return true;
+	}
+
+	// runs of (zero count, literal count, literal bytes), counts are 16 bit
+	static void encode(const std::vector<uint8_t> &in, std::vector<uint8_t> &out)
+	{
+		out.clear();
+		size_t i = 0;
+		while (i < in.size())
+		{
+			uint16_t zeros = 0;
+			while (i < in.size() && in[i] == 0 && zeros < UINT16_MAX)
+			{
+				zeros++;
+				i++;
+			}
+			const size_t literalStart = i;
+			uint16_t literals = 0;
+			while (i < in.size() && in[i] != 0 && literals < UINT16_MAX)
+			{
+				literals++;
+				i++;
+			}
+			out.push_back(static_cast<uint8_t>(zeros));
+			out.push_back(static_cast<uint8_t>(zeros >> 8));
+			out.push_back(static_cast<uint8_t>(literals));
+			out.push_back(static_cast<uint8_t>(literals >> 8));
+			out.insert(out.end(), in.begin() + literalStart, in.begin() + literalStart + literals);
+		}
+	}
+	// returns false when a run would go past the end of either buffer
+	static bool decode(const std::vector<uint8_t> &in, std::vector<uint8_t> &out, size_t size)
+	{
+		out.assign(size, 0);
+		size_t o = 0;
+		size_t i = 0;
+		while (i + 4 <= in.size())
+		{
+			const uint16_t zeros = in[i] | (in[i + 1] << 8);
+			const uint16_t literals = in[i + 2] | (in[i + 3] << 8);
+			i += 4;
+			if (o + zeros + literals > size || i + literals > in.size())
+			{
+				return false;
+			}
+			o += zeros;
+			std::memcpy(out.data() + o, in.data() + i, literals);
+			o += literals;
+			i += literals;
+		}
+		return i == in.size();
+	}
+
+	std::deque<Entry> frames;
+	std::vector<uint8_t> keyframe, scratch;
+	size_t byteBudget;
+	int keyframeInterval;
+	size_t bytesUsed;
+	uint64_t nextSequence;
+	uint64_t cachedKeyframe;	// sequence of the keyframe currently decoded in keyframe
+	bool forceKeyframe;			// set when the budget is exceeded by a single keyframe's group
+};
\ No newline at end of file
@@ -9,22 +9,54 @@ int main(int argc, char *argv[])
 	state.height = 900;
 	state.logW = 640;
 	state.logH = 320;
-	state.mouseClick = false;
 
-	if (!initialize(state))
+	// --benchmark [frames] renders a camera sweep offscreen and exits
+	// --texture-budget <KB> sets how much texture memory may stay resident
+	int benchmarkFrames = 0;
+	size_t textureBudget = TEXTURE_BUDGET_BYTES;
+	for (int i = 1; i < argc; i++)
+	{
+		if (string(argv[i]) == "--texture-budget" && i + 1 < argc)
+		{
+			textureBudget = static_cast<size_t>(SDL_atoi(argv[i + 1])) * 1024;
+		}
+		if (string(argv[i]) == "--benchmark")
+		{
+			benchmarkFrames = i + 1 < argc ? SDL_atoi(argv[i + 1]) : 0;
+			if (benchmarkFrames <= 0)
+			{
+				benchmarkFrames = BENCHMARK_DEFAULT_FRAMES;
+			}
+		}
+	}
+
+	if (benchmarkFrames ? !initializeOffscreen(state) : !initialize(state))
 	{
 		return 1;
 	}
 
 	// load game assets
 	Resources res;
-	res.load(state);
+	res.load(state, textureBudget);
 
 	// setup game data
 	//
 	GameState gs(state);
+	if (benchmarkFrames)
+	{
+		gs.rngState = 0;	// fixed seed so frame checksums are comparable between runs
+	}
 	createTiles(state, gs, res);
+	if (benchmarkFrames)
+	{
+		runBenchmark(state, gs, res, benchmarkFrames);
+		res.unload();
+		cleanup(state);
+		return 0;
+	}
 	uint64_t prevTime = SDL_GetTicks();
+	uint64_t lastLatencyLog = 0;
+	bool rewound = false;
 
 	// start game loop
 	bool running{ true };
@@ -37,6 +69,7 @@ int main(int argc, char *argv[])
 			continue;
 		}
 		prevTime = currTime;
+		const uint64_t frameStart = SDL_GetTicksNS();
 
 		SDL_Event event{ 0 };
 		bool jumped = false;
@@ -56,114 +89,99 @@ int main(int argc, char *argv[])
 					state.height = event.window.data2;
 					break;
 				}
-				case SDL_EVENT_KEY_DOWN:
+				case SDL_EVENT_WINDOW_DISPLAY_CHANGED:
+				case SDL_EVENT_DISPLAY_CURRENT_MODE_CHANGED:
 				{
-					handleKeyInput(state, gs, gs.player(), event.key.scancode, true);
+					updateFramePeriod(state);
 					break;
 				}
-				case SDL_EVENT_KEY_UP:
-				{
-					handleKeyInput(state, gs, gs.player(), event.key.scancode, false);
-					if (event.key.scancode == SDL_SCANCODE_F1)
-					{
-						gs.debugMode = !gs.debugMode;
-					}
-					if (event.key.scancode == SDL_SCANCODE_F11)
-					{
-						state.fullScreen = !state.fullScreen;
-						SDL_SetWindowFullscreen(state.window, state.fullScreen);
-					}
-					break;
-				}
-				case SDL_EVENT_MOUSE_BUTTON_DOWN:
-				{
-					state.mouseClick = true;
-					//handleMouseInput(state, gs, gs.player(), event.button, true);
-					break;
-				}
-				case SDL_EVENT_MOUSE_BUTTON_UP:
-				{
-					state.mouseClick = false;
-					//handleMouseInput(state, gs, gs.player(), event.button, false);
-					break;
-				}
-
 			}
+			recordInputEvent(gs, event);
 		}
+		// everything polled this frame belongs to this tick
+		const uint64_t tickTime = SDL_GetTicksNS();
+		consumeInput(state, gs, res);
+		gs.latency.tickConsumed(tickTime);
 
-		// update all objects
-		for (auto &layer : gs.layers)
+		// hold backspace to rewind through the recorded history instead of simulating
+		if (gs.keys[SDL_SCANCODE_BACKSPACE])
 		{
-			for (GameObject &obj : layer)
+			if (gs.rewind.pop(gs.snapshot) && loadSnapshot(gs, res, gs.snapshot))
 			{
-				update(state, gs, res, obj, deltaTime);
-
-				// update the animation
-				if (obj.currentAnimation != -1)
-				{
-					obj.animations[obj.currentAnimation].step(deltaTime);
-				}
+				rewound = true;
 			}
 		}
-
-		// update spears
-		for (GameObject &spear : gs.spears)
+		else
 		{
-			update(state, gs, res, spear, deltaTime);
+			// behaviours only restart once, from wherever the rewind stopped
+			if (rewound)
+			{
+				startBehaviours(gs, res);
+				rewound = false;
+			}
 
-			// update the animation
-			if (spear.currentAnimation != -1)
+			// point the enemy flow field at the player
+			// the field itself is rebuilt as deferred work, fish use the previous one until then
+			if (gs.flowField.setTarget(gs.player().position.relativeTo(gs.levelOrigin) + glm::vec2(TILE_SIZE / 2.0f)))
 			{
-				spear.animations[spear.currentAnimation].step(deltaTime);
+				gs.frameTasks.submit(TASK_PRIORITY_FLOW_FIELD, [&gs]()
+					{
+						// a rebuild can take several slices per frame, the section adds them up
+						ProfileScope scope(gs.profiler, gs.profFlowField, true);
+						return gs.flowField.rebuild(FLOW_FIELD_SLICE_CELLS);
+					});
 			}
-		}
-		// calculate viewport position
-		gs.mapViewport.x = (gs.player().position.x + TILE_SIZE / 2) - gs.mapViewport.w / 2;
 
-		// perform drawing commands
-		SDL_SetRenderDrawColor(state.renderer, 188, 245, 255, 255);
-		SDL_RenderClear(state.renderer);
+			// advance the simulation clock, resume behaviours whose wait has finished, then update all objects
+			gs.timers.advance(deltaTime);
+			gs.behaviours.run();
+			updateObjects(state, gs, res, deltaTime);
 
-		// draw all  background objects
-		for (GameObject &obj : gs.backgroundTiles)
-		{
-			SDL_FRect dst{
-				.x = obj.position.x - gs.mapViewport.x,
-				.y = obj.position.y,
-				.w = static_cast<float>(TILE_SIZE),
-				.h = static_cast<float>(TILE_SIZE)
-			};
-			SDL_RenderTexture(state.renderer, obj.texture, nullptr, &dst);
-		}
-		// draw all objects
-		for (auto &layer : gs.layers)
-		{
-			for (GameObject &obj : layer)
+			// record the simulation state for rewinding
 			{
-				drawObject(state, gs, obj, TILE_SIZE, TILE_SIZE, deltaTime);
+				ProfileScope scope(gs.profiler, gs.profSnapshot);
+				saveSnapshot(gs, res, gs.snapshot);
+				gs.rewind.push(gs.snapshot);
 			}
 		}
+		// calculate viewport position, the camera only follows the player horizontally
+		WorldPos camera = gs.player().position + glm::vec2(TILE_SIZE / 2.0f - gs.mapViewport.w / 2, 0);
+		camera.chunk.y = 0;
+		camera.local.y = 0;
+		gs.camera = camera;
+		rebaseParticles(gs);
+		updateTextureRegions(gs, res, camera + glm::vec2(gs.player().velocity.x * TEXTURE_LOOKAHEAD, 0));
 
-		// draw spears
-		for (GameObject &spear : gs.spears)
+		// update particles
 		{
-			if (spear.data.spear.state != SpearState::inactive)
-			{
-				drawObject(state, gs, spear, TILE_SIZE, TILE_SIZE, deltaTime);
-			}
+			ProfileScope scope(gs.profiler, gs.profParticleUpdate);
+			gs.particles.update(deltaTime, gs.waterSurface.relativeTo(gs.particleOrigin).y);
 		}
 
-		SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 255);
-		// display debug
-		if (gs.debugMode)
+		// perform drawing commands
+		render(state, gs, res, deltaTime);
+
+		// use the time left before vsync for deferred work, the flow field's share is also shown on its own
 		{
-			SDL_RenderDebugText(state.renderer, 5, 5,
-				format("State: {} Velocity Y: {} dTime: {}",
-						static_cast<int>(gs.player().data.player.state), gs.player().velocity.y, deltaTime).c_str());
+			ProfileScope scope(gs.profiler, gs.profDeferred);
+			gs.profiler.clear(gs.profFlowField);
+			gs.frameTasks.run(frameStart + state.framePeriod - FRAME_BUDGET_MARGIN);
+			gs.profiler.finish(gs.profFlowField);
 		}
+
 		// swap buffers and present
 		SDL_RenderPresent(state.renderer);
+		res.textures.nextFrame();
+
+		const uint64_t presentTime = SDL_GetTicksNS();
+		gs.latency.framePresented(presentTime);
+		if (gs.latency.refresh(presentTime, SDL_NS_PER_SECOND) && presentTime - lastLatencyLog >= LATENCY_LOG_INTERVAL)
+		{
+			lastLatencyLog = presentTime;
+			logLatency(gs);
+		}
 	}
+	logLatency(gs);
 
 	res.unload();
 	cleanup(state);
@@ -201,21 +219,219 @@ bool initialize(SDLState &state)
 	SDL_SetRenderVSync(state.renderer, 1);
 	// configure resolution
 	SDL_SetRenderLogicalPresentation(state.renderer, state.logW, state.logH, SDL_LOGICAL_PRESENTATION_LETTERBOX);
+	updateFramePeriod(state);
 
 	return initSuccess;
 }
 
+bool initializeOffscreen(SDLState &state)
+{
+	// no window or video driver, everything is drawn by the software renderer into a surface
+	if (!SDL_Init(0))
+	{
+		SDL_Log("Error initializing SDL3: %s", SDL_GetError());
+		return false;
+	}
+	state.window = nullptr;
+	state.target = SDL_CreateSurface(state.logW, state.logH, SDL_PIXELFORMAT_ARGB8888);
+	state.renderer = state.target ? SDL_CreateSoftwareRenderer(state.target) : nullptr;
+	if (!state.renderer)
+	{
+		SDL_Log("Error creating software renderer: %s", SDL_GetError());
+		cleanup(state);
+		return false;
+	}
+	return true;
+}
+
 void cleanup(SDLState &state)
 {
 	SDL_DestroyRenderer(state.renderer);
 	SDL_DestroyWindow(state.window);
+	SDL_DestroySurface(state.target);
 	SDL_Quit();
 }
 
-void drawObject(const SDLState &state, GameState &gs, GameObject &obj, float width, float height, float deltaTime)
+void updateFramePeriod(SDLState &state)
+{
+	// called at startup and whenever the window changes display or the display changes mode
+	const SDL_DisplayMode *mode = state.window ? SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(state.window)) : nullptr;
+	const float refreshRate = mode && mode->refresh_rate > 0 ? mode->refresh_rate : 60.0f;
+	state.framePeriod = static_cast<uint64_t>(SDL_NS_PER_SECOND / refreshRate);
+}
+
+void render(const SDLState &state, GameState &gs, Resources &res, float deltaTime)
+{
+	SDL_SetRenderDrawColor(state.renderer, 188, 245, 255, 255);
+	SDL_RenderClear(state.renderer);
+	gs.drawCalls = 0;
+
+	// draw all  background objects
+	for (GameObject &obj : gs.backgroundTiles)
+	{
+		const glm::vec2 screen = obj.position.relativeTo(gs.camera);
+		if (!isOnScreen(gs, screen, TILE_SIZE, TILE_SIZE))
+		{
+			continue;
+		}
+		SDL_FRect dst{
+			.x = screen.x,
+			.y = screen.y,
+			.w = static_cast<float>(TILE_SIZE),
+			.h = static_cast<float>(TILE_SIZE)
+		};
+		SDL_RenderTexture(state.renderer, res.textures.get(obj.texture), nullptr, &dst);
+		gs.drawCalls++;
+	}
+	// draw all objects
+	for (auto &layer : gs.layers)
+	{
+		for (GameObject &obj : layer)
+		{
+			drawObject(state, gs, res, obj, TILE_SIZE, TILE_SIZE, deltaTime);
+		}
+	}
+
+	// draw spears
+	for (GameObject &spear : gs.spears)
+	{
+		if (spear.data.spear.state != SpearState::inactive)
+		{
+			drawObject(state, gs, res, spear, TILE_SIZE, TILE_SIZE, deltaTime);
+		}
+	}
+
+	// draw particles in a single batch
+	{
+		ProfileScope scope(gs.profiler, gs.profParticleDraw);
+		SDL_SetRenderDrawBlendMode(state.renderer, SDL_BLENDMODE_BLEND);
+		const glm::vec2 cameraOffset = gs.camera.relativeTo(gs.particleOrigin);
+		SDL_FRect view = gs.mapViewport;
+		view.x = cameraOffset.x;
+		view.y = cameraOffset.y;
+		gs.drawCalls += gs.particles.draw(state.renderer, view);
+		SDL_SetRenderDrawBlendMode(state.renderer, SDL_BLENDMODE_NONE);
+	}
+
+	SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 255);
+	// display debug
+	if (gs.debugMode)
+	{
+		SDL_RenderDebugText(state.renderer, 5, 5,
+			format("State: {} Velocity Y: {} dTime: {}",
+					static_cast<int>(gs.player().data.player.state), gs.player().velocity.y, deltaTime).c_str());
+		SDL_RenderDebugText(state.renderer, 5, 15,
+			format("Particles: {} Draw calls: {}", gs.particles.getCount(), gs.drawCalls).c_str());
+		const LatencyStats &latency = gs.latency.getPresentStats();
+		SDL_RenderDebugText(state.renderer, 5, 25,
+			format("Input->present p50: {:.1f} p95: {:.1f} p99: {:.1f} ms (tick p50: {:.1f} ms)",
+					latency.p50, latency.p95, latency.p99, gs.latency.getTickStats().p50).c_str());
+		SDL_RenderDebugText(state.renderer, 5, 35, format("Rewind: {} frames, {} KB",
+			gs.rewind.getFrameCount(), gs.rewind.getBytesUsed() / 1024).c_str());
+		SDL_RenderDebugText(state.renderer, 5, 45,
+			format("Textures: {} / {} KB, hits: {} misses: {} evictions: {}",
+				res.textures.getBytesResident() / 1024, res.textures.getBudget() / 1024,
+				res.textures.getHits(), res.textures.getMisses(), res.textures.getEvictions()).c_str());
+		SDL_RenderDebugText(state.renderer, 5, 55, format("LOD near: {} mid: {} far: {}",
+			gs.lodBuckets[LOD_NEAR].size(), gs.lodBuckets[LOD_MID].size(), gs.lodBuckets[LOD_FAR].size()).c_str());
+		SDL_RenderDebugText(state.renderer, 5, 65, format("Behaviours: {} running, {} resumed, timers: {} pending, {} fired",
+			gs.behaviours.getLiveCount(), gs.behaviours.getResumedCount(),
+			gs.timers.getPending(), gs.timers.getFired()).c_str());
+		SDL_RenderDebugText(state.renderer, 5, 75, format("Frame budget: {:.2f} / {:.2f} ms, {} slices, backlog: {} tasks",
+			gs.frameTasks.getUsedMs(), gs.frameTasks.getBudgetMs(), gs.frameTasks.getSlices(), gs.frameTasks.getBacklog()).c_str());
+		drawProfiler(state, gs, 5, 85);
+	}
+}
+
+void runBenchmark(const SDLState &state, GameState &gs, Resources &res, int frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	const float sweepStart = -gs.mapViewport.w;
+	const float sweepEnd = static_cast<float>(MAP_COLS * TILE_SIZE);
+	const Uint64 frequency = SDL_GetPerformanceFrequency();
+	vector<float> frameMs;
+	frameMs.reserve(frames);
+	Uint64 combinedHash = 14695981039346656037ull;
+
+	// scripted camera sweep that scrolls the whole level in from one side and out the other,
+	// so every texture region comes into range and leaves it again
+	const auto sweep = [frames, sweepStart, sweepEnd](int frame)
+		{
+			const float t = frames > 1 ? static_cast<float>(std::min(frame, frames - 1)) / (frames - 1) : 0.0f;
+			return WorldPos() + glm::vec2(sweepStart + (sweepEnd - sweepStart) * t, 0);
+		};
+
+	for (int i = 0; i < frames; i++)
+	{
+		gs.camera = sweep(i);
+		rebaseParticles(gs);
+		updateTextureRegions(gs, res, sweep(i + static_cast<int>(TEXTURE_LOOKAHEAD / deltaTime)));
+
+		// the software renderer rasterizes on present, so that is part of the timing
+		const Uint64 start = SDL_GetPerformanceCounter();
+		render(state, gs, res, deltaTime);
+		SDL_RenderPresent(state.renderer);
+		res.textures.nextFrame();
+		const float ms = (SDL_GetPerformanceCounter() - start) * 1000.0f / frequency;
+		frameMs.push_back(ms);
+
+		// keep deferred work moving outside the timed part, one slice per frame
+		gs.frameTasks.run(0);
+
+		// FNV-1a over the visible pixels, row by row to skip any pitch padding
+		Uint64 hash = 14695981039346656037ull;
+		const SDL_Surface *target = state.target;
+		const int rowBytes = target->w * 4;
+		for (int y = 0; y < target->h; y++)
+		{
+			const Uint8 *row = static_cast<const Uint8 *>(target->pixels) + y * target->pitch;
+			for (int x = 0; x < rowBytes; x++)
+			{
+				hash = (hash ^ row[x]) * 1099511628211ull;
+			}
+		}
+		combinedHash = (combinedHash ^ hash) * 1099511628211ull;
+		SDL_Log("frame %d: %.3f ms, %d draw calls, checksum %016llx",
+			i, ms, gs.drawCalls, static_cast<unsigned long long>(hash));
+	}
+
+	vector<float> sorted = frameMs;
+	sort(sorted.begin(), sorted.end());
+	float total = 0;
+	for (float ms : frameMs)
+	{
+		total += ms;
+	}
+	SDL_Log("benchmark: %d frames, avg %.3f ms, min %.3f ms, p95 %.3f ms, max %.3f ms, checksum %016llx",
+		frames, total / frames, sorted.front(), sorted[static_cast<size_t>(0.95f * (frames - 1))], sorted.back(),
+		static_cast<unsigned long long>(combinedHash));
+	SDL_Log("textures: %zu / %zu KB resident, %llu hits, %llu misses, %llu evictions",
+		res.textures.getBytesResident() / 1024, res.textures.getBudget() / 1024,
+		static_cast<unsigned long long>(res.textures.getHits()), static_cast<unsigned long long>(res.textures.getMisses()),
+		static_cast<unsigned long long>(res.textures.getEvictions()));
+}
+
+bool isOnScreen(const GameState &gs, const glm::vec2 &screen, float width, float height)
+{
+	// textures of objects that are skipped here are not touched, so they can be evicted
+	return screen.x + width > 0 && screen.x < gs.mapViewport.w && screen.y + height > 0 && screen.y < gs.mapViewport.h;
+}
+
+void rebaseParticles(GameState &gs)
+{
+	// keep particle coordinates small by storing them relative to the camera's chunk
+	if (gs.camera.chunk != gs.particleOrigin.chunk)
+	{
+		const WorldPos origin(gs.camera.chunk, glm::vec2(0));
+		gs.particles.shift(gs.particleOrigin.relativeTo(origin));
+		gs.particleOrigin = origin;
+	}
+}
+
+void drawObject(const SDLState &state, GameState &gs, Resources &res, GameObject &obj, float width, float height, float deltaTime)
 {
 	float srcX = obj.currentAnimation != -1 
-		? obj.animations[obj.currentAnimation].currentFrame() * width : 0.0f;
+		? obj.animations[obj.currentAnimation].currentFrame(gs.timers.now()) * width : 0.0f;
 	SDL_FRect src{
 		.x = srcX,
 		.y = 0,
@@ -223,32 +439,137 @@ void drawObject(const SDLState &state, GameState &gs, GameObject &obj, float wid
 		.h = height
 	};
 
+	// draw relative to the camera so large world coordinates never reach the renderer
+	const glm::vec2 screen = obj.position.relativeTo(gs.camera);
+	if (!isOnScreen(gs, screen, width, height))
+	{
+		return;
+	}
 	SDL_FRect dst{
-		.x = obj.position.x - gs.mapViewport.x,
-		.y = obj.position.y,
+		.x = screen.x,
+		.y = screen.y,
 		.w = width,
 		.h = height
 	};
 
 	SDL_FlipMode flipMode = obj.direction == -1 ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
-	SDL_RenderTextureRotated(state.renderer, obj.texture, &src, &dst, 0, nullptr, flipMode);
+	SDL_RenderTextureRotated(state.renderer, res.textures.get(obj.texture), &src, &dst, 0, nullptr, flipMode);
+	gs.drawCalls++;
 
 	if (gs.debugMode)
 	{
 		SDL_FRect rectA
 		{
-			.x = obj.position.x + obj.collider.x - gs.mapViewport.x,
-			.y = obj.position.y + obj.collider.y,
+			.x = screen.x + obj.collider.x,
+			.y = screen.y + obj.collider.y,
 			.w = obj.collider.w,
 			.h = obj.collider.h
 		};
 		SDL_SetRenderDrawBlendMode(state.renderer, SDL_BLENDMODE_BLEND);
 		SDL_SetRenderDrawColor(state.renderer, 255, 0, 0, 100);
 		SDL_RenderFillRect(state.renderer, &rectA);
+		gs.drawCalls++;
 		SDL_SetRenderDrawBlendMode(state.renderer, SDL_BLENDMODE_NONE);
 	}
 }
 
+void drawProfiler(const SDLState &state, GameState &gs, float x, float y)
+{
+	for (const ProfileSection &section : gs.profiler.getSections())
+	{
+		SDL_RenderDebugText(state.renderer, x, y, format("{}: {:.3f} ms", section.name, section.averageMs).c_str());
+		y += 10;
+	}
+}
+
+void logLatency(GameState &gs)
+{
+	const LatencyStats &present = gs.latency.getPresentStats();
+	const LatencyStats &tick = gs.latency.getTickStats();
+	SDL_Log("Input latency over %d inputs: present p50 %.2f p95 %.2f p99 %.2f ms, tick p50 %.2f p95 %.2f p99 %.2f ms",
+		present.samples, present.p50, present.p95, present.p99, tick.p50, tick.p95, tick.p99);
+}
+
+void updateObjects(const SDLState &state, GameState &gs, Resources &res, float deltaTime)
+{
+	// bucket characters by how far they are from the view, using last frame's camera,
+	// level tiles never move and have nothing to update
+	for (vector<GameObject *> &bucket : gs.lodBuckets)
+	{
+		bucket.clear();
+	}
+	for (GameObject &obj : gs.layers[LAYER_IDX_CHARACTERS])
+	{
+		// resting fish hold still until their behaviour wakes them, there is nothing to update
+		if (obj.type == ObjectType::enemy && obj.data.enemy.state == EnemyState::resting)
+		{
+			continue;
+		}
+		obj.lagTime += deltaTime;
+		gs.lodBuckets[lodBucket(gs, obj)].push_back(&obj);
+	}
+
+	// apply all time owed to an object, in steps small enough to keep collisions stable
+	const auto catchUp = [&state, &gs, &res](GameObject &obj)
+		{
+			while (obj.lagTime > 0)
+			{
+				const float step = std::min(obj.lagTime, LOD_MID_STEP);
+				update(state, gs, res, obj, step);
+				obj.lagTime -= step;
+			}
+		};
+
+	// near objects update every tick
+	{
+		ProfileScope scope(gs.profiler, gs.profLod[LOD_NEAR]);
+		for (GameObject *obj : gs.lodBuckets[LOD_NEAR])
+		{
+			catchUp(*obj);
+		}
+	}
+
+	// mid range objects wait until a whole mid step has built up
+	{
+		ProfileScope scope(gs.profiler, gs.profLod[LOD_MID]);
+		for (GameObject *obj : gs.lodBuckets[LOD_MID])
+		{
+			if (obj->lagTime >= LOD_MID_STEP)
+			{
+				catchUp(*obj);
+			}
+		}
+	}
+
+	// far objects are frozen, the time they miss is applied once they come back in range
+	{
+		ProfileScope scope(gs.profiler, gs.profLod[LOD_FAR]);
+		for (GameObject *obj : gs.lodBuckets[LOD_FAR])
+		{
+			obj->lagTime = std::min(obj->lagTime, LOD_MAX_LAG);
+		}
+	}
+
+	// spears are deactivated as soon as they leave the view, so they always update
+	for (GameObject &spear : gs.spears)
+	{
+		update(state, gs, res, spear, deltaTime);
+	}
+}
+
+LodBucket lodBucket(const GameState &gs, const GameObject &obj)
+{
+	const glm::vec2 screen = obj.position.relativeTo(gs.camera);
+	const float dx = std::max({ -screen.x - TILE_SIZE, screen.x - gs.mapViewport.w, 0.0f });
+	const float dy = std::max({ -screen.y - TILE_SIZE, screen.y - gs.mapViewport.h, 0.0f });
+	const float distance = std::max(dx, dy);
+	if (obj.type == ObjectType::player || distance <= LOD_NEAR_DISTANCE)
+	{
+		return LOD_NEAR;
+	}
+	return distance <= LOD_MID_DISTANCE ? LOD_MID : LOD_FAR;
+}
+
 void update(const SDLState &state, GameState &gs, Resources &res, GameObject &obj, float deltaTime)
 {
 	// apply gravity
@@ -260,25 +581,36 @@ void update(const SDLState &state, GameState &gs, Resources &res, GameObject &ob
 	float currentDirection = 0.0f;
 	if (obj.type == ObjectType::player)
 	{
-		if (state.keys[SDL_SCANCODE_A])
+		if (gs.keys[SDL_SCANCODE_A])
 		{
 			currentDirection += -1.0f;
 		}
-		if (state.keys[SDL_SCANCODE_D])
+		if (gs.keys[SDL_SCANCODE_D])
 		{
 			currentDirection += 1.0f;
 		}
 
 		Timer &weaponTimer = obj.data.player.weaponTimer;
-		weaponTimer.step(deltaTime);
+
+		// breathe out bubbles while under water
+		Timer &bubbleTimer = obj.data.player.bubbleTimer;
+		if (bubbleTimer.isTimeout(gs.timers.now()))
+		{
+			bubbleTimer.reset(gs.timers.now());
+			if (obj.position.relativeTo(gs.waterSurface).y + obj.collider.y > 0)
+			{
+				const WorldPos mouth = obj.position + glm::vec2(obj.direction < 0 ? 10.0f : 22.0f, 10.0f);
+				gs.particles.emit(res.bubbleEmitter, mouth.relativeTo(gs.particleOrigin), 1 + SDL_rand(3));
+			}
+		}
 
 		const auto handleShooting = [&state, &gs, &res, &obj, &weaponTimer]()
 		{
-			if (state.mouseClick) //(state.mouse == SDL_BUTTON_LEFT)	// shoot spear
+			if (gs.mouseClick) //(state.mouse == SDL_BUTTON_LEFT)	// shoot spear
 			{
-				if (weaponTimer.isTimeout())
+				if (weaponTimer.isTimeout(gs.timers.now()))
 				{
-					weaponTimer.reset();
+					weaponTimer.reset(gs.timers.now());
 					GameObject spear;
 					spear.data.spear = SpearData();
 					spear.type = ObjectType::spear;
@@ -291,7 +623,7 @@ void update(const SDLState &state, GameState &gs, Resources &res, GameObject &ob
 						.h = 5.0f,
 					};
 					const int yVariation = 15;
-					const float yVelocity = SDL_rand(yVariation) - yVariation / 2.0f;
+					const float yVelocity = SDL_rand_r(&gs.rngState, yVariation) - yVariation / 2.0f;
 					spear.velocity = glm::vec2(200.0f * obj.direction, yVelocity);
 					spear.maxSpeedX = 1000.0f;
 					spear.animations = res.spearAnims;
@@ -299,10 +631,7 @@ void update(const SDLState &state, GameState &gs, Resources &res, GameObject &ob
 					// adjust spear start position
 					const float left = -10.0f;
 					const float right = 10.0f;
-					spear.position = glm::vec2(
-						obj.position.x + (obj.direction < 0 ? left : right),
-						obj.position.y
-					);
+					spear.position = obj.position + glm::vec2(obj.direction < 0 ? left : right, 0);
 					// overwrite inactive spear if possible to save space
 					bool foundInactive = false;
 					for (int i = 0; i < gs.spears.size() && !foundInactive; i++)
@@ -378,24 +707,36 @@ void update(const SDLState &state, GameState &gs, Resources &res, GameObject &ob
 		{
 			case SpearState::moving:
 			{
-				if (obj.position.x - gs.mapViewport.x < 0 ||	// if spear is off screen
-					obj.position.x - gs.mapViewport.x > state.logW ||
-					obj.position.y - gs.mapViewport.y < 0 ||
-					obj.position.y - gs.mapViewport.y > state.logH)
+				const glm::vec2 screen = obj.position.relativeTo(gs.camera);
+				if (screen.x < 0 ||	// if spear is off screen
+					screen.x > state.logW ||
+					screen.y < 0 ||
+					screen.y > state.logH)
 				{
 					obj.data.spear.state = SpearState::inactive;
 				}
 				break;
 			}
-			case SpearState::colliding:
+			case SpearState::colliding:	// spearHitBehaviour deactivates it once the hit animation is done
 			{
-				if (obj.animations[obj.currentAnimation].isDone())
-				{
-					obj.data.spear.state = SpearState::inactive;
-				}
 				break;
 			}
-
+		}
+	}
+	else if (obj.type == ObjectType::enemy)
+	{
+		// steer along the shared flow field, where it gives no direction (the player's cell,
+		// unreachable cells) the fish holds position rather than swimming through rock,
+		// slowing fish glide to a stop
+		glm::vec2 desired(0);
+		if (obj.data.enemy.state == EnemyState::chasing)
+		{
+			desired = gs.flowField.getDirection(obj.position.relativeTo(gs.levelOrigin) + glm::vec2(TILE_SIZE / 2.0f));
+		}
+		obj.velocity += (desired * obj.maxSpeedX - obj.velocity) * std::min(ENEMY_TURN_RATE * deltaTime, 1.0f);
+		if (desired.x)
+		{
+			obj.direction = desired.x < 0 ? -1.0f : 1.0f;
 		}
 	}
 	if (currentDirection)
@@ -414,29 +755,42 @@ void update(const SDLState &state, GameState &gs, Resources &res, GameObject &ob
 	obj.position += obj.velocity * deltaTime;
 
 	// handle collision detection
+	const uint32_t mask = collisionMask(obj.type);
 	bool foundGround = false;
-	for (auto &layer : gs.layers)
+	for (size_t i = 0; i < gs.layers.size(); i++)
 	{
-		for (GameObject &objB : layer)
+		// skip whole layers when nothing in them can interact with this object
+		const bool canCollide = mask & gs.layerCategories[i];
+		const bool canGround = obj.dynamic && (gs.layerCategories[i] & collisionCategory(ObjectType::level));
+		if (!canCollide && !canGround)
+		{
+			continue;
+		}
+		for (GameObject &objB : gs.layers[i])
 		{
 			if (&obj != &objB)
 			{
-				checkCollision(state, gs, res, obj, objB, deltaTime);
+				if (mask & collisionCategory(objB.type))
+				{
+					checkCollision(state, gs, res, obj, objB, deltaTime);
+				}
 
 				// grounded sensor
-				if (objB.type != ObjectType::level)	// only check grounded against level
+				if (!obj.dynamic || objB.type != ObjectType::level)	// only check grounded against level
 				{
 					continue;
 				}
+				// in obj's local space
 				SDL_FRect sensor{
-					.x = obj.position.x + obj.collider.x,
-					.y = obj.position.y + obj.collider.y + obj.collider.h,
+					.x = obj.collider.x,
+					.y = obj.collider.y + obj.collider.h,
 					.w = obj.collider.w,
 					.h = 1
 				};
+				const glm::vec2 offsetB = objB.position.relativeTo(obj.position);
 				SDL_FRect rectB{
-					.x = objB.position.x + objB.collider.x,
-					.y = objB.position.y + objB.collider.y,
+					.x = offsetB.x + objB.collider.x,
+					.y = offsetB.y + objB.collider.y,
 					.w = objB.collider.w,
 					.h = objB.collider.h
 				};
@@ -456,23 +810,29 @@ void update(const SDLState &state, GameState &gs, Resources &res, GameObject &ob
 		{
 			obj.data.player.state = PlayerState::running;
 		}
+		if (foundGround)
+		{
+			gs.behaviours.wake(obj.wait, BehaviourEvent::grounded);
+		}
 	}
 }
 
 
 void checkCollision(const SDLState &state, GameState &gs, Resources &res, GameObject &a, GameObject &b, float deltaTime)
 {
+	// test in a's local space so precision does not depend on where in the world the pair is
+	const glm::vec2 offsetB = b.position.relativeTo(a.position);
 	SDL_FRect rectA
 	{
-		.x = a.position.x + a.collider.x,
-		.y = a.position.y + a.collider.y,
+		.x = a.collider.x,
+		.y = a.collider.y,
 		.w = a.collider.w,
 		.h = a.collider.h
 	};
 	SDL_FRect rectB
 	{
-		.x = b.position.x + b.collider.x,
-		.y = b.position.y + b.collider.y,
+		.x = offsetB.x + b.collider.x,
+		.y = offsetB.y + b.collider.y,
 		.w = b.collider.w,
 		.h = b.collider.h
 	};
@@ -497,11 +857,11 @@ void collisionResponse(const SDLState &state, GameState &gs, Resources &res,
 				// horizontal collision
 				if (objA.velocity.x > 0) // going right
 				{
-					objA.position.x -= rectC.w;
+					objA.position += glm::vec2(-rectC.w, 0);
 				}
 				else if (objA.velocity.x < 0) // going left
 				{
-					objA.position.x += rectC.w;
+					objA.position += glm::vec2(rectC.w, 0);
 				}
 				objA.velocity.x = 0;
 			}
@@ -510,11 +870,11 @@ void collisionResponse(const SDLState &state, GameState &gs, Resources &res,
 				// vertical collision
 				if (objA.velocity.y > 0) // going down
 				{
-					objA.position.y -= rectC.h;
+					objA.position += glm::vec2(0, -rectC.h);
 				}
 				else if (objA.velocity.y < 0) // going up
 				{
-					objA.position.y += rectC.h;
+					objA.position += glm::vec2(0, rectC.h);
 				}
 				objA.velocity.y = 0;
 			}
@@ -531,17 +891,26 @@ void collisionResponse(const SDLState &state, GameState &gs, Resources &res,
 			}
 		}
 	}
-	else if (objA.type == ObjectType::spear && objB.type != ObjectType::player)
+	else if (objA.type == ObjectType::spear)
 	{
 		switch (objA.data.spear.state)
 		{
 			case SpearState::moving:
 			{
 				genericResponse();
+
+				// kick up silt away from the impact
+				ParticleEmitter silt = res.siltEmitter;
+				silt.velocity = glm::vec2(-objA.direction * 20.0f, -10.0f);
+				const WorldPos impact = objA.position + glm::vec2(rectC.x + rectC.w / 2, rectC.y + rectC.h / 2);
+				gs.particles.emit(silt, impact.relativeTo(gs.particleOrigin), 24);
+
 				objA.velocity *= 0;
 				objA.data.spear.state = SpearState::colliding;
 				objA.texture = res.texSpearHit;
 				objA.currentAnimation = res.ANIM_SPEAR_HIT;
+				objA.animations[objA.currentAnimation].reset(gs.timers.now());
+				gs.behaviours.spawn(spearHitBehaviour(gs, &objA - gs.spears.data()));
 				break;
 			}
 		}
@@ -549,125 +918,514 @@ void collisionResponse(const SDLState &state, GameState &gs, Resources &res,
 }
 void createTiles(const SDLState &state, GameState &gs, const Resources &res)
 {
-	/*
-	*	1 - Player
-	*	2 - Boat
-	*	3 - Surface
-	*	4 - Shallow Water
-	*	5 - Medium Water
-	*   6 - Deep Water
-	*	7 - Rock
-	*	8 - Treasure
-	*/
-	short map[MAP_ROWS][MAP_COLS] = {
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 7, 0, 7, 0, 0, 0, 0, 0, 8, 0, 0, 0, 0, 0, 0 },
-		{ 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7 }
-	};
-	short background[MAP_ROWS][MAP_COLS] = {
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-		{ 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3 },
-		{ 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4 },
-		{ 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5 },
-		{ 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6 },
-		{ 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6 },
-		{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
-	};
+	// the level is validated and compiled at build time from levels/level1.txt (see level.h),
+	// so loading only walks the precompiled tile and spawn lists
+	const auto createObject = [&state](int r, int c, TextureId tex, ObjectType type)
+		{
+			GameObject o;
+			o.type = type;
+			o.position = WorldPos::fromPixels(c * TILE_SIZE, state.logH - (MAP_ROWS - r) * TILE_SIZE);
+			o.texture = tex;
+			o.collider = { .x = 0, .y = 0, .w = TILE_SIZE, .h = TILE_SIZE };
+			return o;
+		};
+
+	gs.tileGrid.assign(LEVEL_1.grid.begin(), LEVEL_1.grid.end());
+	for (const LevelTile &t : LEVEL_1.tiles)
+	{
+		GameObject tile = createObject(t.row, t.col, res.tileTextures[t.code], ObjectType::level);
+		tile.collider = res.tileColliders[t.code];
+		gs.layers[LAYER_IDX_LEVEL].push_back(tile);
+	}
+	for (const LevelTile &t : LEVEL_1.background)
+	{
+		gs.backgroundTiles.push_back(createObject(t.row, t.col, res.tileTextures[t.code], ObjectType::level));
+	}
+	if (LEVEL_1.waterRow != -1)
+	{
+		gs.waterSurface = WorldPos::fromPixels(0, state.logH - (MAP_ROWS - LEVEL_1.waterRow) * TILE_SIZE);
+	}
+
+	// create player
+	GameObject player = createObject(LEVEL_1.player.row, LEVEL_1.player.col, res.texDiverStanding, ObjectType::player);
+	player.data.player = PlayerData();
+	player.animations = res.playerAnims;
+	player.currentAnimation = res.ANIM_PLAYER_IDLE;
+	player.acceleration = glm::vec2(300, 0);
+	player.maxSpeedX = 100;
+	player.dynamic = true;
+	player.collider = { .x = 11, .y = 6, .w = 10, .h = 20 };
+	gs.layers[LAYER_IDX_CHARACTERS].push_back(player);
+	gs.playerIndex = gs.layers[LAYER_IDX_CHARACTERS].size() - 1;
+
+	// create schools of fish
+	for (const LevelTile &t : LEVEL_1.fish)
+	{
+		for (int i = 0; i < FISH_PER_SCHOOL; i++)
+		{
+			GameObject fish = createObject(t.row, t.col, res.texFish, ObjectType::enemy);
+			fish.data.enemy = EnemyData();
+			fish.position += glm::vec2(SDL_randf_r(&gs.rngState) * 16.0f - 8.0f, SDL_randf_r(&gs.rngState) * 16.0f - 8.0f);
+			fish.animations = res.fishAnims;
+			fish.currentAnimation = res.ANIM_FISH_SWIM;
+			fish.maxSpeedX = 40.0f + SDL_randf_r(&gs.rngState) * 20.0f;
+			fish.collider = { .x = 8, .y = 10, .w = 18, .h = 12 };
+			gs.layers[LAYER_IDX_CHARACTERS].push_back(fish);
+		}
+	}
+
+	for (size_t i = 0; i < gs.layers.size(); i++)
+	{
+		for (const GameObject &obj : gs.layers[i])
+		{
+			gs.layerCategories[i] |= collisionCategory(obj.type);
+		}
+	}
+	buildFlowField(state, gs);
+	buildTextureRegions(gs);
+	startBehaviours(gs, res);
+}
 
-	const auto loadMap = [&state, &gs, &res](short layer[MAP_ROWS][MAP_COLS])
+void buildTextureRegions(GameState &gs)
+{
+	// each region is a few tiles wide and lists the tile textures it needs
+	gs.regionTextures.assign((MAP_COLS * TILE_SIZE + TEXTURE_REGION_SIZE - 1) / TEXTURE_REGION_SIZE, vector<TextureId>());
+	const auto addTiles = [&gs](const vector<GameObject> &tiles)
 		{
-			const auto createObject = [&state](int r, int c, SDL_Texture *tex, ObjectType type)
+			for (const GameObject &tile : tiles)
+			{
+				const int r = static_cast<int>(tile.position.relativeTo(gs.levelOrigin).x) / TEXTURE_REGION_SIZE;
+				vector<TextureId> &region = gs.regionTextures[r];
+				if (find(region.begin(), region.end(), tile.texture) == region.end())
 				{
-					GameObject o;
-					o.type = type;
-					o.position = glm::vec2(c * TILE_SIZE, state.logH - (MAP_ROWS - r) * TILE_SIZE);
-					o.texture = tex;
-					o.collider = { .x = 0, .y = 0, .w = TILE_SIZE, .h = TILE_SIZE };
-					return o;
-				};
-			for (int r = 0; r < MAP_ROWS; r++)
+					region.push_back(tile.texture);
+				}
+			}
+		};
+	addTiles(gs.layers[LAYER_IDX_LEVEL]);
+	addTiles(gs.backgroundTiles);
+}
+
+void updateTextureRegions(GameState &gs, Resources &res, const WorldPos &predictedCamera)
+{
+	// hold references for the regions in view and where the camera is heading, plus one
+	// on each side, so textures about to scroll in stay loaded and ones left behind become evictable
+	const int lastRegion = static_cast<int>(gs.regionTextures.size()) - 1;
+	const auto regionOf = [&gs](const WorldPos &pos)
+		{
+			return static_cast<int>(std::floor(pos.relativeTo(gs.levelOrigin).x / TEXTURE_REGION_SIZE));
+		};
+	const int viewRegions = static_cast<int>(gs.mapViewport.w) / TEXTURE_REGION_SIZE + 1;
+	const int cameraRegion = regionOf(gs.camera);
+	const int predictedRegion = regionOf(predictedCamera);
+	const int first = std::clamp(std::min(cameraRegion, predictedRegion) - 1, 0, lastRegion + 1);
+	const int last = std::clamp(std::max(cameraRegion, predictedRegion) + viewRegions + 1, -1, lastRegion);
+	if (first == gs.regionFirst && last == gs.regionLast)
+	{
+		return;
+	}
+	vector<TextureId> entered;
+	for (int r = first; r <= last; r++)
+	{
+		for (TextureId id : gs.regionTextures[r])
+		{
+			res.textures.acquire(id);
+		}
+		if (r >= gs.regionFirst && r <= gs.regionLast)
+		{
+			continue;
+		}
+		if (r >= cameraRegion && r <= cameraRegion + viewRegions)
+		{
+			// already in view (first frame, teleports, rewinds), it is drawn this frame anyway
+			for (TextureId id : gs.regionTextures[r])
 			{
-				for (int c = 0; c < MAP_COLS; c++)
+				res.textures.prefetch(id);
+			}
+		}
+		else
+		{
+			entered.insert(entered.end(), gs.regionTextures[r].begin(), gs.regionTextures[r].end());
+		}
+	}
+
+	// the rest is only needed once the camera gets there, so load it a few at a time
+	// as deferred work after this frame is drawn
+	if (!entered.empty())
+	{
+		gs.frameTasks.submit(TASK_PRIORITY_TEXTURE_PREFETCH, [&res, entered, next = size_t(0)]() mutable
+			{
+				res.textures.prefetch(entered[next++]);
+				return next == entered.size();
+			});
+	}
+	for (int r = gs.regionFirst; r <= gs.regionLast; r++)
+	{
+		for (TextureId id : gs.regionTextures[r])
+		{
+			res.textures.release(id);
+		}
+	}
+	gs.regionFirst = first;
+	gs.regionLast = last;
+}
+
+void buildFlowField(const SDLState &state, GameState &gs)
+{
+	// fish can only swim through open water below the surface,
+	// positions are looked up relative to gs.levelOrigin
+	vector<uint8_t> blocked(MAP_ROWS * MAP_COLS, 0);
+	for (int r = 0; r < MAP_ROWS; r++)
+	{
+		for (int c = 0; c < MAP_COLS; c++)
+		{
+			const int i = r * MAP_COLS + c;
+			blocked[i] = gs.tileGrid[i] != TILE_EMPTY || r < LEVEL_1.waterRow;
+		}
+	}
+	gs.flowField.build(MAP_ROWS, MAP_COLS, TILE_SIZE, glm::vec2(0), blocked);
+}
+
+void saveSnapshot(const GameState &gs, const Resources &res, vector<uint8_t> &out)
+{
+	// level tiles never change, so only characters and spears are recorded
+	const vector<GameObject> &characters = gs.layers[LAYER_IDX_CHARACTERS];
+	SnapshotWriter writer(out);
+
+	// timers are stored as time elapsed or left, the clock itself is never rewound
+	const double now = gs.timers.now();
+	writer.write(SnapshotHeader{
+		.characterCount = static_cast<uint32_t>(characters.size()),
+		.spearCount = static_cast<uint32_t>(gs.spears.size()),
+		.rngState = gs.rngState,
+		.treasureTime = static_cast<float>(gs.treasureEmitTime - now),
+		.treasureArmed = gs.treasureArmed
+	});
+	const auto writeObject = [&writer, &res, now](const GameObject &obj)
+		{
+			ObjectRecord r{};
+			r.chunk = obj.position.chunk;
+			r.position = obj.position.local;
+			r.velocity = obj.velocity;
+			r.collider = obj.collider;
+			r.direction = obj.direction;
+			r.maxSpeedX = obj.maxSpeedX;
+			r.lagTime = obj.lagTime;
+			if (obj.type == ObjectType::player)
+			{
+				r.weaponTime = obj.data.player.weaponTimer.getTime(now);
+				r.weaponTimeout = obj.data.player.weaponTimer.isTimeout(now);
+				r.bubbleTime = obj.data.player.bubbleTimer.getTime(now);
+				r.bubbleTimeout = obj.data.player.bubbleTimer.isTimeout(now);
+				r.state = static_cast<uint8_t>(obj.data.player.state);
+			}
+			else if (obj.type == ObjectType::spear)
+			{
+				r.state = static_cast<uint8_t>(obj.data.spear.state);
+			}
+			else if (obj.type == ObjectType::enemy)
+			{
+				r.state = static_cast<uint8_t>(obj.data.enemy.state);
+				r.phaseTime = static_cast<float>(obj.data.enemy.phaseEnd - now);
+			}
+			r.type = static_cast<uint8_t>(obj.type);
+			r.grounded = obj.grounded;
+			r.currentAnimation = static_cast<int8_t>(obj.currentAnimation);
+			r.texture = static_cast<int8_t>(obj.texture);
+			r.animationCount = static_cast<uint8_t>(obj.animations.size());
+			writer.write(r);
+			for (const Animation &anim : obj.animations)
+			{
+				writer.write(AnimationRecord{ .time = anim.getTimer().getTime(now), .timeout = anim.getTimer().isTimeout(now) });
+			}
+		};
+	for (const GameObject &obj : characters)
+	{
+		writeObject(obj);
+	}
+	for (const GameObject &spear : gs.spears)
+	{
+		writeObject(spear);
+	}
+}
+
+bool loadSnapshot(GameState &gs, const Resources &res, const vector<uint8_t> &in)
+{
+	vector<GameObject> &characters = gs.layers[LAYER_IDX_CHARACTERS];
+
+	// walk the whole snapshot before applying any of it, so one that does not match
+	// the current objects is rejected without leaving the game half restored
+	SnapshotReader check(in);
+	SnapshotHeader header;
+	if (!check.read(header) || header.characterCount != characters.size())
+	{
+		return false;
+	}
+	const auto checkObject = [&check](size_t animationCount)
+		{
+			ObjectRecord r;
+			if (!check.read(r) || r.animationCount != animationCount)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < animationCount; i++)
+			{
+				AnimationRecord a;
+				if (!check.read(a))
 				{
-					switch (layer[r][c])
-					{
-					case 1:	// player
-					{
-						// create player
-						GameObject player = createObject(r, c, res.texDiverStanding, ObjectType::player);
-						player.data.player = PlayerData();
-						player.animations = res.playerAnims;
-						player.currentAnimation = res.ANIM_PLAYER_IDLE;
-						player.acceleration = glm::vec2(300, 0);
-						player.maxSpeedX = 100;
-						player.dynamic = true;
-						player.collider = { .x = 11, .y = 6, .w = 10, .h = 20 };
-						gs.layers[LAYER_IDX_CHARACTERS].push_back(player);
-						gs.playerIndex = gs.layers[LAYER_IDX_CHARACTERS].size() - 1;
-						break;
-					}
-					case 2:	// boat
-					{
-						GameObject boat = createObject(r, c, res.texBoat, ObjectType::level);
-						boat.collider.y = 30.0f;
-						boat.collider.h = 2.0f;
-						gs.layers[LAYER_IDX_LEVEL].push_back(boat);
-						break;
-					}
-					case 3:	// surface
-					{
-						GameObject surface = createObject(r, c, res.texSurface, ObjectType::level);
-						gs.backgroundTiles.push_back(surface);
-						break;
-					}
-					case 4:	// shallow water
-					{
-						GameObject shallowWater = createObject(r, c, res.texShallowWater, ObjectType::level);
-						gs.backgroundTiles.push_back(shallowWater);
-						break;
-					}
-					case 5:	// medium water
-					{
-						GameObject mediumWater = createObject(r, c, res.texMediumWater, ObjectType::level);
-						gs.backgroundTiles.push_back(mediumWater);
-						break;
-					}
-					case 6:	// deep water
-					{
-						GameObject deepWater = createObject(r, c, res.texDeepWater, ObjectType::level);
-						gs.backgroundTiles.push_back(deepWater);
-						break;
-					}
-					case 7:	// rock
-					{
-						GameObject rock = createObject(r, c, res.texRock, ObjectType::level);
-						gs.layers[LAYER_IDX_LEVEL].push_back(rock);
-						break;
-					}
-					case 8:	//treasure
-					{
-						GameObject treasure = createObject(r, c, res.texTreasure, ObjectType::level);
-						gs.layers[LAYER_IDX_LEVEL].push_back(treasure);
-						break;
-					}
-					}
+					return false;
 				}
 			}
+			return true;
+		};
+	for (const GameObject &obj : characters)
+	{
+		if (!checkObject(obj.animations.size()))
+		{
+			return false;
+		}
+	}
+	for (size_t i = 0; i < header.spearCount; i++)
+	{
+		if (!checkObject(i < gs.spears.size() ? gs.spears[i].animations.size() : res.spearAnims.size()))
+		{
+			return false;
+		}
+	}
+
+	// every read below is known to succeed
+	SnapshotReader reader(in);
+	reader.read(header);
+	const double now = gs.timers.now();
+	const auto readObject = [&reader, now](GameObject &obj)
+		{
+			ObjectRecord r;
+			reader.read(r);
+			obj.position = WorldPos(r.chunk, r.position);
+			obj.velocity = r.velocity;
+			obj.collider = r.collider;
+			obj.direction = r.direction;
+			obj.maxSpeedX = r.maxSpeedX;
+			obj.lagTime = r.lagTime;
+			if (obj.type == ObjectType::player)
+			{
+				obj.data.player.weaponTimer.setState(now, r.weaponTime, r.weaponTimeout);
+				obj.data.player.bubbleTimer.setState(now, r.bubbleTime, r.bubbleTimeout);
+				obj.data.player.state = static_cast<PlayerState>(r.state);
+			}
+			else if (obj.type == ObjectType::spear)
+			{
+				obj.data.spear.state = static_cast<SpearState>(r.state);
+			}
+			else if (obj.type == ObjectType::enemy)
+			{
+				obj.data.enemy.state = static_cast<EnemyState>(r.state);
+				obj.data.enemy.phaseEnd = now + r.phaseTime;
+			}
+			obj.grounded = r.grounded;
+			obj.currentAnimation = r.currentAnimation;
+			obj.texture = r.texture;
+			for (Animation &anim : obj.animations)
+			{
+				AnimationRecord a;
+				reader.read(a);
+				anim.getTimer().setState(now, a.time, a.timeout);
+			}
 		};
-	loadMap(map);
-	loadMap(background);
-	assert(gs.playerIndex != -1);
+	for (GameObject &obj : characters)
+	{
+		readObject(obj);
+	}
 
+	// spears come and go, recreate any that are missing before filling them in
+	const size_t oldSpearCount = gs.spears.size();
+	gs.spears.resize(header.spearCount);
+	for (size_t i = oldSpearCount; i < gs.spears.size(); i++)
+	{
+		gs.spears[i].type = ObjectType::spear;
+		gs.spears[i].data.spear = SpearData();
+		gs.spears[i].animations = res.spearAnims;
+	}
+	for (GameObject &spear : gs.spears)
+	{
+		readObject(spear);
+	}
+	gs.rngState = header.rngState;
+	gs.treasureArmed = header.treasureArmed != 0;
+	gs.treasureEmitTime = now + header.treasureTime;
+	return true;
+}
+
+void startBehaviours(GameState &gs, const Resources &res)
+{
+	// coroutine frames are not part of snapshots, so behaviours start over from the
+	// object state whenever the simulation state is replaced
+	gs.behaviours.clear();
+	vector<GameObject> &characters = gs.layers[LAYER_IDX_CHARACTERS];
+	for (size_t i = 0; i < characters.size(); i++)
+	{
+		characters[i].wait = BehaviourWait();
+		if (characters[i].type == ObjectType::enemy)
+		{
+			gs.behaviours.spawn(fishBehaviour(gs, i));
+		}
+	}
+	for (size_t i = 0; i < gs.spears.size(); i++)
+	{
+		gs.spears[i].wait = BehaviourWait();
+		if (gs.spears[i].data.spear.state == SpearState::colliding)
+		{
+			gs.behaviours.spawn(spearHitBehaviour(gs, i));
+		}
+	}
+	gs.behaviours.spawn(treasureScript(gs, res));
+}
+
+// objects are looked up by index after every wait, the vectors holding them can grow in between
+Behaviour fishBehaviour(GameState &gs, size_t index)
+{
+	// chase the player in bursts, glide to a stop and rest in between, nothing runs while waiting
+	// the deadline of each state lives on the fish, so a restored snapshot sleeps out what was
+	// left of it and only draws from the rng where the original run did
+	for (;;)
+	{
+		co_await WaitSeconds{ static_cast<float>(gs.layers[LAYER_IDX_CHARACTERS][index].data.enemy.phaseEnd - gs.timers.now()) };
+		GameObject &fish = gs.layers[LAYER_IDX_CHARACTERS][index];
+		const double now = gs.timers.now();
+		if (fish.data.enemy.state == EnemyState::chasing)
+		{
+			fish.data.enemy.state = EnemyState::slowing;
+			fish.data.enemy.phaseEnd = now + 0.5f;
+		}
+		else if (fish.data.enemy.state == EnemyState::slowing)
+		{
+			fish.data.enemy.state = EnemyState::resting;
+			fish.data.enemy.phaseEnd = now + 1.0f + SDL_randf_r(&gs.rngState) * 2.0f;
+			fish.velocity = glm::vec2(0);
+		}
+		else
+		{
+			fish.data.enemy.state = EnemyState::chasing;
+			fish.data.enemy.phaseEnd = now + 3.0f + SDL_randf_r(&gs.rngState) * 3.0f;
+		}
+	}
+}
+
+Behaviour spearHitBehaviour(GameState &gs, size_t index)
+{
+	co_await waitAnimationDone(gs.spears[index], gs.timers.now());
+	gs.spears[index].data.spear.state = SpearState::inactive;
+}
+
+Behaviour treasureScript(GameState &gs, const Resources &res)
+{
+	// once the diver has landed, the treasure starts giving itself away with bubbles
+	// the next emission time is part of the game state, so a restored snapshot keeps the rhythm
+	if (!gs.treasureArmed)
+	{
+		co_await waitUntilGrounded(gs.player());
+		gs.treasureArmed = true;
+		gs.treasureEmitTime = gs.timers.now() + 1.0f;
+	}
+	for (;;)
+	{
+		co_await WaitSeconds{ static_cast<float>(gs.treasureEmitTime - gs.timers.now()) };
+		for (const LevelTile &t : LEVEL_1.tiles)
+		{
+			if (t.code == TILE_TREASURE)
+			{
+				const WorldPos pos = gs.levelOrigin + glm::vec2(t.col * TILE_SIZE + TILE_SIZE / 2.0f, t.row * TILE_SIZE);
+				gs.particles.emit(res.bubbleEmitter, pos.relativeTo(gs.particleOrigin), 4);
+			}
+		}
+		gs.treasureEmitTime = gs.timers.now() + 2.5f;
+	}
+}
+
+void recordInputEvent(GameState &gs, const SDL_Event &event)
+{
+	// keep the timestamp SDL gave the event so latency is measured from when it arrived
+	InputEvent input{ .timestamp = event.common.timestamp, .type = event.type,
+		.scancode = SDL_SCANCODE_UNKNOWN, .button = 0, .repeat = false };
+	switch (event.type)
+	{
+		case SDL_EVENT_KEY_DOWN:
+		case SDL_EVENT_KEY_UP:
+		{
+			input.scancode = event.key.scancode;
+			input.repeat = event.key.repeat;
+			break;
+		}
+		case SDL_EVENT_MOUSE_BUTTON_DOWN:
+		case SDL_EVENT_MOUSE_BUTTON_UP:
+		{
+			input.button = event.button.button;
+			break;
+		}
+		default:
+		{
+			return;
+		}
+	}
+	gs.inputEvents.push_back(input);
+}
+
+void consumeInput(SDLState &state, GameState &gs, Resources &res)
+{
+	for (const InputEvent &event : gs.inputEvents)
+	{
+		switch (event.type)
+		{
+			case SDL_EVENT_KEY_DOWN:
+			{
+				if (!event.repeat)
+				{
+					gs.latency.inputReceived(event.timestamp);
+				}
+				gs.keys[event.scancode] = true;
+				handleKeyInput(state, gs, gs.player(), event.scancode, true);
+				break;
+			}
+			case SDL_EVENT_KEY_UP:
+			{
+				gs.latency.inputReceived(event.timestamp);
+				gs.keys[event.scancode] = false;
+				handleKeyInput(state, gs, gs.player(), event.scancode, false);
+				if (event.scancode == SDL_SCANCODE_F1)
+				{
+					gs.debugMode = !gs.debugMode;
+				}
+				if (event.scancode == SDL_SCANCODE_F11)
+				{
+					state.fullScreen = !state.fullScreen;
+					SDL_SetWindowFullscreen(state.window, state.fullScreen);
+				}
+				if (event.scancode == SDL_SCANCODE_F5)
+				{
+					saveSnapshot(gs, res, gs.quickSave);
+				}
+				if (event.scancode == SDL_SCANCODE_F9 && loadSnapshot(gs, res, gs.quickSave))
+				{
+					gs.rewind.clear();	// the recorded history is now in the future
+					startBehaviours(gs, res);
+				}
+				break;
+			}
+			case SDL_EVENT_MOUSE_BUTTON_DOWN:
+			{
+				gs.latency.inputReceived(event.timestamp);
+				handleMouseInput(state, gs, gs.player(), event.button, true);
+				break;
+			}
+			case SDL_EVENT_MOUSE_BUTTON_UP:
+			{
+				gs.latency.inputReceived(event.timestamp);
+				handleMouseInput(state, gs, gs.player(), event.button, false);
+				break;
+			}
+		}
+	}
+	gs.inputEvents.clear();
 }
 
 void handleKeyInput(const SDLState &state, GameState &gs, GameObject &obj,
@@ -702,7 +1460,11 @@ void handleKeyInput(const SDLState &state, GameState &gs, GameObject &obj,
 }
 
 void handleMouseInput(const SDLState &state, GameState &gs, GameObject &obj,
-	SDL_MouseButtonEvent mouse, bool mouseDown)
+	Uint8 button, bool mouseDown)
 {
+	if (button == SDL_BUTTON_LEFT)
+	{
+		gs.mouseClick = mouseDown;
+	}
 
 }
\ No newline at end of file
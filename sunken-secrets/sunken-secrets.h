@@ -7,25 +7,73 @@
 #include <array>
 #include "animation.h"
 #include "game_object.h"
+#include "particles.h"
+#include "flow_field.h"
+#include "latency.h"
+#include "level.h"
+#include "snapshot.h"
+#include "world_pos.h"
+#include "texture_residency.h"
+#include "input_event.h"
+#include "frame_scheduler.h"
+#include "profiler.h"
 #include <format>
 using namespace std;
 
 const size_t LAYER_IDX_LEVEL = 0;
 const size_t LAYER_IDX_CHARACTERS = 1;
-const int MAP_ROWS = 10;
-const int MAP_COLS = 20;
+const int MAP_ROWS = LEVEL_1.rows;
+const int MAP_COLS = LEVEL_1.cols;
 const int TILE_SIZE = 32;
+const int FISH_PER_SCHOOL = 6;
+const float ENEMY_TURN_RATE = 3.0f;
+const uint64_t LATENCY_LOG_INTERVAL = 5 * SDL_NS_PER_SECOND;
+const size_t REWIND_BUDGET_BYTES = 1024 * 1024;
+const int REWIND_KEYFRAME_INTERVAL = 30;
+const int BENCHMARK_DEFAULT_FRAMES = 600;
+// level 1 needs well under 1 MB resident, a small --texture-budget <KB> such as 64 exercises eviction
+const size_t TEXTURE_BUDGET_BYTES = 4 * 1024 * 1024;
+const int TEXTURE_REGION_SIZE = 4 * TILE_SIZE;	// width of the level columns textures are held for
+const size_t INPUT_EVENTS_RESERVE = 256;	// room for one frame of events without reallocating
+
+// deferred work runs between the end of rendering and this long before the next vsync
+const uint64_t FRAME_BUDGET_MARGIN = 2 * SDL_NS_PER_MS;
+const int FLOW_FIELD_SLICE_CELLS = 512;
+const float TEXTURE_LOOKAHEAD = 0.5f;	// seconds of camera movement textures are prefetched ahead of
+
+// frame task priorities, higher runs first
+const int TASK_PRIORITY_TEXTURE_PREFETCH = 0;
+const int TASK_PRIORITY_FLOW_FIELD = 10;
+
+// simulation level of detail, distances are measured from the edge of the view,
+// with the view as wide as level 1 nothing is ever more than about 10 tiles outside it
+const float LOD_NEAR_DISTANCE = 2 * TILE_SIZE;
+const float LOD_MID_DISTANCE = 6 * TILE_SIZE;
+const float LOD_MID_STEP = 0.1f;	// mid range objects update at 10 Hz, also the largest catch up step
+const float LOD_MAX_LAG = 2.0f;		// far objects stop accumulating missed time beyond this
+
+enum LodBucket
+{
+	LOD_NEAR,
+	LOD_MID,
+	LOD_FAR,
+	LOD_BUCKET_COUNT
+};
 
 struct SDLState
 {
 	SDL_Window *window;
 	SDL_Renderer *renderer;
+	SDL_Surface *target;	// offscreen render target in benchmark mode
 	int width, height, logW, logH;
-	const bool *keys;
-	bool mouseClick;
+	uint64_t framePeriod;	// nanoseconds between vsyncs, see updateFramePeriod()
 	bool fullScreen;
-	SDLState() : keys(SDL_GetKeyboardState(nullptr)) 
+	SDLState()
 	{
+		window = nullptr;
+		renderer = nullptr;
+		target = nullptr;
+		framePeriod = SDL_NS_PER_SECOND / 60;
 		fullScreen = false;
 	}
 
@@ -39,29 +87,29 @@ struct Resources
 	const int ANIM_SPEAR_MOVING = 0;
 	const int ANIM_SPEAR_HIT = 1;
 	vector<Animation> spearAnims;
+	const int ANIM_FISH_SWIM = 0;
+	vector<Animation> fishAnims;
 
-	vector<SDL_Texture *> textures;
-	SDL_Texture *texDiverStanding;
-	SDL_Texture *texDiverRunning;
-	SDL_Texture *texBoat;
-	SDL_Texture *texShallowWater;
-	SDL_Texture *texMediumWater;
-	SDL_Texture *texDeepWater;
-	SDL_Texture *texRock;
-	SDL_Texture *texSurface;
-	SDL_Texture *texTreasure;
-	SDL_Texture *texSpear;
-	SDL_Texture *texSpearHit;
-
-	SDL_Texture *loadTexture(SDL_Renderer *renderer, const string& filepath)
-	{
-		SDL_Texture *tex = IMG_LoadTexture(renderer, filepath.c_str());
-		SDL_SetTextureScaleMode(tex, SDL_SCALEMODE_NEAREST);
-		textures.push_back(tex);
-		return tex;
-	}
+	ParticleEmitter bubbleEmitter;
+	ParticleEmitter siltEmitter;
 
-	void load(SDLState& state)
+	TextureResidency textures;
+	TextureId texDiverStanding;
+	TextureId texDiverRunning;
+	TextureId texBoat;
+	TextureId texShallowWater;
+	TextureId texMediumWater;
+	TextureId texDeepWater;
+	TextureId texRock;
+	TextureId texSurface;
+	TextureId texTreasure;
+	TextureId texSpear;
+	TextureId texSpearHit;
+	TextureId texFish;
+	array<TextureId, TILE_CODE_COUNT> tileTextures;
+	array<SDL_FRect, TILE_CODE_COUNT> tileColliders{};
+
+	void load(SDLState& state, size_t textureBudget)
 	{
 		playerAnims.resize(5);
 		playerAnims[ANIM_PLAYER_IDLE] = Animation(1, 0.5f);
@@ -69,42 +117,158 @@ struct Resources
 		spearAnims.resize(2);
 		spearAnims[ANIM_SPEAR_MOVING] = Animation(1, 0.05f);
 		spearAnims[ANIM_SPEAR_HIT] = Animation(3, 0.15f);
+		fishAnims.resize(1);
+		fishAnims[ANIM_FISH_SWIM] = Animation(2, 0.4f);
+
+		bubbleEmitter.velocity = glm::vec2(0, -10.0f);
+		bubbleEmitter.velocitySpread = glm::vec2(8.0f, 5.0f);
+		bubbleEmitter.positionSpread = glm::vec2(2.0f, 1.0f);
+		bubbleEmitter.buoyancy = 60.0f;
+		bubbleEmitter.drag = 1.5f;
+		bubbleEmitter.life = 2.5f;
+		bubbleEmitter.lifeSpread = 0.5f;
+		bubbleEmitter.size = 2.0f;
+		bubbleEmitter.color = SDL_FColor{ 0.9f, 0.97f, 1.0f, 0.8f };
+
+		siltEmitter.velocitySpread = glm::vec2(40.0f, 30.0f);
+		siltEmitter.positionSpread = glm::vec2(2.0f, 2.0f);
+		siltEmitter.buoyancy = -15.0f;
+		siltEmitter.drag = 3.0f;
+		siltEmitter.life = 1.2f;
+		siltEmitter.lifeSpread = 0.4f;
+		siltEmitter.size = 1.0f;
+		siltEmitter.color = SDL_FColor{ 0.55f, 0.5f, 0.4f, 0.9f };
+
+		// textures are only registered here, they load when first drawn
+		textures.initialize(state.renderer, textureBudget);
+		texDiverStanding = textures.add("res/diver_standing.png");
+		texDiverRunning = textures.add("res/diver_running.png");
+		texBoat = textures.add("res/boat.png");
+		texShallowWater = textures.add("res/shallow_water.png");
+		texMediumWater = textures.add("res/medium_water.png");
+		texDeepWater = textures.add("res/deep_water.png");
+		texRock = textures.add("res/rock.png");
+		texSurface = textures.add("res/water_surface.png");
+		texTreasure = textures.add("res/treasure.png");
+		texSpear = textures.add("res/spear.png");
+		texSpearHit = textures.add("res/spear_hit.png");
+		texFish = textures.add("res/fish.png");
+
+		// characters can be anywhere in the level, so their textures stay resident
+		for (TextureId id : { texDiverStanding, texDiverRunning, texSpear, texSpearHit, texFish })
+		{
+			textures.acquire(id);
+		}
 
-		texDiverStanding = loadTexture(state.renderer, "res/diver_standing.png");
-		texDiverRunning = loadTexture(state.renderer, "res/diver_running.png");
-		texBoat = loadTexture(state.renderer, "res/boat.png");
-		texShallowWater = loadTexture(state.renderer, "res/shallow_water.png");
-		texMediumWater = loadTexture(state.renderer, "res/medium_water.png");
-		texDeepWater = loadTexture(state.renderer, "res/deep_water.png");
-		texRock = loadTexture(state.renderer, "res/rock.png");
-		texSurface = loadTexture(state.renderer, "res/water_surface.png");
-		texTreasure = loadTexture(state.renderer, "res/treasure.png");
-		texSpear = loadTexture(state.renderer, "res/spear.png");
-		texSpearHit = loadTexture(state.renderer, "res/spear_hit.png");
+		// lookup tables for compiled level tiles
+		tileTextures.fill(NO_TEXTURE);
+		tileTextures[TILE_BOAT] = texBoat;
+		tileTextures[TILE_SURFACE] = texSurface;
+		tileTextures[TILE_SHALLOW_WATER] = texShallowWater;
+		tileTextures[TILE_MEDIUM_WATER] = texMediumWater;
+		tileTextures[TILE_DEEP_WATER] = texDeepWater;
+		tileTextures[TILE_ROCK] = texRock;
+		tileTextures[TILE_TREASURE] = texTreasure;
+		tileColliders.fill(SDL_FRect{ .x = 0, .y = 0, .w = TILE_SIZE, .h = TILE_SIZE });
+		tileColliders[TILE_BOAT] = SDL_FRect{ .x = 0, .y = 30.0f, .w = TILE_SIZE, .h = 2.0f };	// only the deck is solid
 	}
 
 	void unload()
 	{
-		for (SDL_Texture *tex : textures)
-		{
-			SDL_DestroyTexture(tex);
-		}
+		textures.unloadAll();
 	}
 };
 
+// the parts of a GameObject that change during simulation, ordered so there is no padding
+struct ObjectRecord
+{
+	glm::ivec2 chunk;
+	glm::vec2 position, velocity;
+	SDL_FRect collider;
+	float direction, maxSpeedX;
+	float weaponTime, bubbleTime, lagTime;
+	float phaseTime;	// time left in a fish's current state
+	uint8_t weaponTimeout, bubbleTimeout;
+	uint8_t type, state, grounded;
+	int8_t currentAnimation, texture;
+	uint8_t animationCount;
+};
+
+struct AnimationRecord
+{
+	float time;
+	uint32_t timeout;
+};
+
+struct SnapshotHeader
+{
+	uint32_t characterCount;
+	uint32_t spearCount;
+	Uint64 rngState;
+	float treasureTime;	// time left until the next treasure bubbles
+	uint32_t treasureArmed;
+};
+
 struct GameState
 {
 	array<vector<GameObject>, 2> layers;
+	array<uint32_t, 2> layerCategories;	// collision categories present in each layer
 	vector<GameObject> backgroundTiles;
+	vector<uint8_t> tileGrid;	// solid tile codes, MAP_ROWS x MAP_COLS
+	vector<vector<TextureId>> regionTextures;	// textures used by each TEXTURE_REGION_SIZE wide column of the level
+	int regionFirst, regionLast;				// regions currently holding a reference
 	vector<GameObject> spears;
+	vector<InputEvent> inputEvents;	// input polled this frame, consumed at the start of the tick
+	TimerWheel timers;	// simulation clock, also wakes sleeping behaviours
+	BehaviourScheduler behaviours;
+	FrameScheduler frameTasks;
+	array<bool, SDL_SCANCODE_COUNT> keys;	// key state as of the events consumed so far
+	bool mouseClick;
 	//vector<GameObject> foregroundTiles;
+	ParticleSystem particles;
+	FlowField flowField;
+	Profiler profiler;
+	LatencyTracker latency;
+	RewindBuffer rewind;
+	vector<uint8_t> snapshot, quickSave;
+	Uint64 rngState;	// all simulation randomness comes from here so snapshots can restore it
+	bool treasureArmed;			// the diver has landed and the treasure gives off bubbles
+	double treasureEmitTime;	// simulation time of the next treasure bubbles
+	int profParticleUpdate, profParticleDraw, profFlowField, profDeferred, profSnapshot;
+	array<int, LOD_BUCKET_COUNT> profLod;
+	array<vector<GameObject *>, LOD_BUCKET_COUNT> lodBuckets;	// rebuilt every tick
+	int drawCalls;
 	int playerIndex;
-	SDL_FRect mapViewport;
+	WorldPos camera;			// top left of the visible area
+	WorldPos levelOrigin;		// top left of tile 0, 0
+	WorldPos waterSurface;
+	WorldPos particleOrigin;	// particles are stored relative to this, it follows the camera's chunk
+	SDL_FRect mapViewport;		// size of the visible area, relative to the camera
 	bool debugMode;
 
-	GameState(const SDLState &state)
+	GameState(const SDLState &state) : behaviours(timers), rewind(REWIND_BUDGET_BYTES, REWIND_KEYFRAME_INTERVAL)
 	{
+		rngState = SDL_GetPerformanceCounter();
 		playerIndex = -1;
+		drawCalls = 0;
+		regionFirst = 0;
+		regionLast = -1;
+		layerCategories.fill(0);
+		inputEvents.reserve(INPUT_EVENTS_RESERVE);
+		keys.fill(false);
+		mouseClick = false;
+		treasureArmed = false;
+		treasureEmitTime = 0;
+		levelOrigin = WorldPos::fromPixels(0, state.logH - MAP_ROWS * TILE_SIZE);
+		waterSurface = levelOrigin;
+		profParticleUpdate = profiler.addSection("Particle update");
+		profParticleDraw = profiler.addSection("Particle draw");
+		profFlowField = profiler.addSection("Flow field");
+		profDeferred = profiler.addSection("Deferred work");
+		profSnapshot = profiler.addSection("Snapshot");
+		profLod[LOD_NEAR] = profiler.addSection("Update near");
+		profLod[LOD_MID] = profiler.addSection("Update mid");
+		profLod[LOD_FAR] = profiler.addSection("Update far");
 		mapViewport = SDL_FRect{
 			.x = 0,
 			.y = 0,
@@ -119,14 +283,35 @@ struct GameState
 
 void cleanup(SDLState &state);
 bool initialize(SDLState& state);
-void drawObject(const SDLState &state, GameState &gs, GameObject &obj, float width, float height, float deltaTime);
+bool initializeOffscreen(SDLState &state);
+void updateFramePeriod(SDLState &state);
+void render(const SDLState &state, GameState &gs, Resources &res, float deltaTime);
+void runBenchmark(const SDLState &state, GameState &gs, Resources &res, int frames);
+bool isOnScreen(const GameState &gs, const glm::vec2 &screen, float width, float height);
+void rebaseParticles(GameState &gs);
+void drawObject(const SDLState &state, GameState &gs, Resources &res, GameObject &obj, float width, float height, float deltaTime);
+void drawProfiler(const SDLState &state, GameState &gs, float x, float y);
+void logLatency(GameState &gs);
+void updateObjects(const SDLState &state, GameState &gs, Resources &res, float deltaTime);
+LodBucket lodBucket(const GameState &gs, const GameObject &obj);
 void update(const SDLState &state, GameState &gs, Resources &res, GameObject &obj, float deltaTime);
 void createTiles(const SDLState &state, GameState &gs, const Resources &res);
+void buildFlowField(const SDLState &state, GameState &gs);
+void buildTextureRegions(GameState &gs);
+void updateTextureRegions(GameState &gs, Resources &res, const WorldPos &predictedCamera);
+void startBehaviours(GameState &gs, const Resources &res);
+Behaviour fishBehaviour(GameState &gs, size_t index);
+Behaviour spearHitBehaviour(GameState &gs, size_t index);
+Behaviour treasureScript(GameState &gs, const Resources &res);
+void saveSnapshot(const GameState &gs, const Resources &res, vector<uint8_t> &out);
+bool loadSnapshot(GameState &gs, const Resources &res, const vector<uint8_t> &in);
 void checkCollision(const SDLState &state, GameState &gs, Resources &res, GameObject &a, GameObject &b, float deltaTime);
 void collisionResponse(const SDLState &state, GameState &gs, Resources &res,
 	const SDL_FRect &rectA, const SDL_FRect &rectB, const SDL_FRect &rectC,
 	GameObject &objA, GameObject &objB, float deltaTime);
+void recordInputEvent(GameState &gs, const SDL_Event &event);
+void consumeInput(SDLState &state, GameState &gs, Resources &res);
 void handleKeyInput(const SDLState &state, GameState &gs, GameObject &obj,
 	SDL_Scancode key, bool keyDown);
 void handleMouseInput(const SDLState &state, GameState &gs, GameObject &obj,
-	SDL_MouseButtonEvent mouse, bool mouseDown);
\ No newline at end of file
+	Uint8 button, bool mouseDown);
\ No newline at end of file
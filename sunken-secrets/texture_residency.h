@@ -0,0 +1,176 @@
+#pragma once
+#include <SDL3/SDL.h>
+#include <SDL3_image/SDL_image.h>
+#include <string>
+#include <vector>
+#include <list>
+
+using TextureId = int;
+const TextureId NO_TEXTURE = -1;
+
+// loads textures on first use and evicts the least recently used unreferenced ones
+// once the resident size goes over budget
+class TextureResidency
+{
+public:
+	TextureResidency() : renderer(nullptr), budget(0), bytesResident(0), frame(0), hits(0), misses(0), evictions(0) {}
+
+	void initialize(SDL_Renderer *renderer, size_t budget)
+	{
+		this->renderer = renderer;
+		this->budget = budget;
+	}
+
+	// registers a texture without loading it
+	TextureId add(const std::string &filepath)
+	{
+		entries.push_back(Entry{ .filepath = filepath, .texture = nullptr, .bytes = 0, .refCount = 0,
+			.lastUsedFrame = 0, .failed = false, .lru = lru.end() });
+		return static_cast<TextureId>(entries.size()) - 1;
+	}
+
+	// referenced textures are never evicted
+	void acquire(TextureId id)
+	{
+		entries[id].refCount++;
+	}
+	void release(TextureId id)
+	{
+		entries[id].refCount--;
+	}
+
+	SDL_Texture *get(TextureId id)
+	{
+		if (id == NO_TEXTURE)
+		{
+			return nullptr;
+		}
+		Entry &entry = entries[id];
+		entry.lastUsedFrame = frame;
+		if (entry.texture)
+		{
+			hits++;
+			lru.splice(lru.begin(), lru, entry.lru);
+			return entry.texture;
+		}
+		if (entry.failed)
+		{
+			return nullptr;
+		}
+
+		misses++;
+		load(id);
+		return entry.texture;
+	}
+
+	// loads a texture ahead of use if something still holds a reference to it,
+	// returns true if it is resident afterwards
+	bool prefetch(TextureId id)
+	{
+		Entry &entry = entries[id];
+		if (!entry.texture && !entry.failed && entry.refCount > 0)
+		{
+			load(id);
+		}
+		return entry.texture != nullptr;
+	}
+
+	// call once per frame, textures drawn in the current frame are not evicted
+	void nextFrame()
+	{
+		frame++;
+		evict();
+	}
+
+	void unloadAll()
+	{
+		for (Entry &entry : entries)
+		{
+			SDL_DestroyTexture(entry.texture);
+			entry.texture = nullptr;
+			entry.lru = lru.end();
+		}
+		lru.clear();
+		bytesResident = 0;
+	}
+
+	size_t getBudget() const
+	{
+		return budget;
+	}
+	size_t getBytesResident() const
+	{
+		return bytesResident;
+	}
+	Uint64 getHits() const
+	{
+		return hits;
+	}
+	Uint64 getMisses() const
+	{
+		return misses;
+	}
+	Uint64 getEvictions() const
+	{
+		return evictions;
+	}
+private:
+	struct Entry
+	{
+		std::string filepath;
+		SDL_Texture *texture;
+		size_t bytes;
+		int refCount;
+		Uint64 lastUsedFrame;
+		bool failed;	// loading failed once, it is not retried
+		std::list<TextureId>::iterator lru;
+	};
+
+	void load(TextureId id)
+	{
+		Entry &entry = entries[id];
+		entry.texture = IMG_LoadTexture(renderer, entry.filepath.c_str());
+		if (!entry.texture)
+		{
+			SDL_Log("Error loading texture %s: %s", entry.filepath.c_str(), SDL_GetError());
+			entry.failed = true;
+			return;
+		}
+		SDL_SetTextureScaleMode(entry.texture, SDL_SCALEMODE_NEAREST);
+		float w = 0, h = 0;
+		SDL_GetTextureSize(entry.texture, &w, &h);
+		entry.bytes = static_cast<size_t>(w * h * 4);
+		bytesResident += entry.bytes;
+		lru.push_front(id);
+		entry.lru = lru.begin();
+		evict();
+	}
+
+	void evict()
+	{
+		auto it = lru.end();
+		while (bytesResident > budget && it != lru.begin())
+		{
+			--it;
+			Entry &entry = entries[*it];
+			if (entry.refCount > 0 || entry.lastUsedFrame == frame)
+			{
+				continue;
+			}
+			SDL_DestroyTexture(entry.texture);
+			entry.texture = nullptr;
+			bytesResident -= entry.bytes;
+			evictions++;
+			it = lru.erase(it);
+			entry.lru = lru.end();
+		}
+	}
+
+	SDL_Renderer *renderer;
+	std::vector<Entry> entries;
+	std::list<TextureId> lru;	// most recently used first
+	size_t budget;
+	size_t bytesResident;
+	Uint64 frame;
+	Uint64 hits, misses, evictions;
+};
\ No newline at end of file
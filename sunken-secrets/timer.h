@@ -1,40 +1,37 @@
 #pragma once
+#include <cmath>
 
+// remembers when it was started on the simulation clock (GameState::timers.now()),
+// nothing needs stepping since the elapsed time is worked out from the start
 class Timer
 {
 public:
-	Timer(float length) : length(length), time(0), timeout(false) {}
+	Timer(float length) : length(length), start(0) {}
 
-	void step(float deltaTime)
+	bool isTimeout(double now) const
 	{
-		time += deltaTime;
-		if (time >= length)
-		{
-			time -= length;
-			timeout = true;
-		}
+		return now - start >= length;
 	}
-
-	bool isTimeout() const 
+	// time into the current period, wraps around like a looping animation
+	float getTime(double now) const
 	{
-		return timeout;
+		const double elapsed = now - start;
+		return static_cast<float>(elapsed < length || length <= 0 ? elapsed : std::fmod(elapsed, static_cast<double>(length)));
 	}
-	float getTime() const
+	float getLength() const
 	{
-		return time;
-	}
-	float getLength() const 
-	{ 
 		return length;
 	}
-	void reset()
+	void reset(double now)
 	{
-		time = 0;
-		timeout = false;
+		start = now;
 	}
-	
+	void setState(double now, float time, bool timeout)
+	{
+		start = now - time - (timeout ? length : 0.0f);
+	}
+
 private:
 	float length;
-	float time;
-	bool timeout;
+	double start;	// simulation time the timer was started at
 };
\ No newline at end of file
@@ -0,0 +1,206 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// identifies a scheduled callback, stays safe to cancel after it fired
+using TimerId = uint64_t;
+const TimerId NO_TIMER = 0;
+
+// hierarchical timing wheel with 1 ms resolution, schedule and cancel are O(1)
+// and advancing only touches the slots that come due
+// its time is the simulation clock, GameState owns one and it only advances while simulating
+class TimerWheel
+{
+public:
+	using Callback = std::function<void()>;
+
+	TimerWheel() : time(0), currentTick(0), freeList(-1), pending(0), fired(0)
+	{
+		for (auto &level : slots)
+		{
+			level.fill(-1);
+		}
+	}
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	// simulation time in seconds
+	double now() const
+	{
+		return time;
+	}
+
+	// an empty callback is not scheduled and gives NO_TIMER
+	TimerId schedule(float delay, Callback callback)
+	{
+		if (!callback)
+		{
+			return NO_TIMER;
+		}
+		const uint64_t due = static_cast<uint64_t>(std::ceil((time + std::max(delay, 0.0f)) * TICKS_PER_SECOND));
+		const int n = allocate();
+		nodes[n].expiry = std::max(due, currentTick + 1);
+		nodes[n].callback = std::move(callback);
+		nodes[n].scheduled = true;
+		insert(n);
+		pending++;
+		return (static_cast<uint64_t>(nodes[n].generation) << 32) | static_cast<uint32_t>(n + 1);
+	}
+
+	void cancel(TimerId id)
+	{
+		const int n = static_cast<int>(id & 0xFFFFFFFF) - 1;
+		if (n < 0 || n >= static_cast<int>(nodes.size()) || nodes[n].generation != (id >> 32) || !nodes[n].scheduled)
+		{
+			return;
+		}
+		unlink(n);
+		release(n);
+		pending--;
+	}
+
+	// call once per simulation tick, runs the callbacks of everything that came due
+	void advance(float deltaTime)
+	{
+		time += deltaTime;
+		fired = 0;
+		const uint64_t target = static_cast<uint64_t>(time * TICKS_PER_SECOND);
+		while (currentTick < target)
+		{
+			tick();
+		}
+	}
+
+	int getPending() const
+	{
+		return pending;
+	}
+	int getFired() const
+	{
+		return fired;
+	}
+private:
+	static const int LEVELS = 4;
+	static const int SLOT_BITS = 6;
+	static const int SLOTS = 1 << SLOT_BITS;
+	static constexpr double TICKS_PER_SECOND = 1000.0;
+
+	struct Node
+	{
+		uint64_t expiry;
+		int prev, next;
+		int level, slot;
+		uint32_t generation;
+		bool scheduled;
+		Callback callback;
+	};
+
+	int allocate()
+	{
+		if (freeList == -1)
+		{
+			nodes.push_back(Node{ .expiry = 0, .prev = -1, .next = -1, .level = 0, .slot = 0, .generation = 1, .scheduled = false, .callback = nullptr });
+			return static_cast<int>(nodes.size()) - 1;
+		}
+		const int n = freeList;
+		freeList = nodes[n].next;
+		return n;
+	}
+	void release(int n)
+	{
+		nodes[n].callback = nullptr;
+		nodes[n].scheduled = false;
+		nodes[n].generation++;
+		nodes[n].next = freeList;
+		freeList = n;
+	}
+
+	// the level is picked by how far away the expiry is, the slot by the expiry's digits at that level
+	void insert(int n)
+	{
+		Node &node = nodes[n];
+		const uint64_t delta = node.expiry - currentTick;
+		int level = 0;
+		while (level < LEVELS - 1 && delta >= (1ull << ((level + 1) * SLOT_BITS)))
+		{
+			level++;
+		}
+		node.level = level;
+		node.slot = static_cast<int>((node.expiry >> (level * SLOT_BITS)) & (SLOTS - 1));
+		node.prev = -1;
+		node.next = slots[level][node.slot];
+		if (node.next != -1)
+		{
+			nodes[node.next].prev = n;
+		}
+		slots[level][node.slot] = n;
+	}
+	void unlink(int n)
+	{
+		const Node &node = nodes[n];
+		if (node.prev != -1)
+		{
+			nodes[node.prev].next = node.next;
+		}
+		else
+		{
+			slots[node.level][node.slot] = node.next;
+		}
+		if (node.next != -1)
+		{
+			nodes[node.next].prev = node.prev;
+		}
+	}
+	int detach(int level, int slot)
+	{
+		const int head = slots[level][slot];
+		slots[level][slot] = -1;
+		return head;
+	}
+
+	void tick()
+	{
+		currentTick++;
+
+		// each time a level wraps, the next slot of the level above is spread out below it
+		int top = 0;
+		while (top < LEVELS - 1 && (currentTick & ((1ull << ((top + 1) * SLOT_BITS)) - 1)) == 0)
+		{
+			top++;
+		}
+		for (int level = top; level > 0; level--)
+		{
+			int n = detach(level, static_cast<int>((currentTick >> (level * SLOT_BITS)) & (SLOTS - 1)));
+			while (n != -1)
+			{
+				const int next = nodes[n].next;
+				insert(n);
+				n = next;
+			}
+		}
+
+		// callbacks may schedule or cancel timers, so each node is freed before its callback runs
+		const int slot = static_cast<int>(currentTick & (SLOTS - 1));
+		while (slots[0][slot] != -1)
+		{
+			const int n = slots[0][slot];
+			unlink(n);
+			Callback callback = std::move(nodes[n].callback);
+			release(n);
+			pending--;
+			fired++;
+			callback();
+		}
+	}
+
+	double time;
+	uint64_t currentTick;
+	std::vector<Node> nodes;
+	std::array<std::array<int, SLOTS>, LEVELS> slots;	// list heads, -1 when empty
+	int freeList;
+	int pending, fired;
+};
\ No newline at end of file
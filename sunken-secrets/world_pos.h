@@ -0,0 +1,69 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <cmath>
+
+const int CHUNK_SIZE = 1024;	// pixels, a power of two keeps the chunk math exact
+
+// position in the world as an integer chunk plus a small float offset inside it,
+// so precision does not degrade with distance from the world origin
+struct WorldPos
+{
+	glm::ivec2 chunk;
+	glm::vec2 local;	// kept in [0, CHUNK_SIZE)
+
+	WorldPos() : chunk(0), local(0) {}
+	WorldPos(glm::ivec2 chunk, glm::vec2 local) : chunk(chunk), local(local)
+	{
+		normalize();
+	}
+
+	// exact for any integer pixel coordinate, used for tile placement
+	static WorldPos fromPixels(int x, int y)
+	{
+		const glm::ivec2 chunk(floorDiv(x), floorDiv(y));
+		return WorldPos(chunk, glm::vec2(static_cast<float>(x - chunk.x * CHUNK_SIZE),
+			static_cast<float>(y - chunk.y * CHUNK_SIZE)));
+	}
+
+	WorldPos &operator+=(glm::vec2 offset)
+	{
+		local += offset;
+		normalize();
+		return *this;
+	}
+	WorldPos operator+(glm::vec2 offset) const
+	{
+		WorldPos p = *this;
+		p += offset;
+		return p;
+	}
+
+	// offset from origin to this position, precise as long as the two are near each other
+	glm::vec2 relativeTo(const WorldPos &origin) const
+	{
+		return glm::vec2(static_cast<float>((chunk.x - origin.chunk.x) * CHUNK_SIZE),
+			static_cast<float>((chunk.y - origin.chunk.y) * CHUNK_SIZE)) + (local - origin.local);
+	}
+private:
+	static int floorDiv(int v)
+	{
+		return (v >= 0 ? v : v - CHUNK_SIZE + 1) / CHUNK_SIZE;
+	}
+	static void normalizeAxis(int &c, float &l)
+	{
+		const float carry = std::floor(l / CHUNK_SIZE);
+		c += static_cast<int>(carry);
+		l -= carry * CHUNK_SIZE;
+		// a tiny negative value rounds up to exactly CHUNK_SIZE, which is the start of the next chunk
+		if (l >= CHUNK_SIZE)
+		{
+			c++;
+			l = 0;
+		}
+	}
+	void normalize()
+	{
+		normalizeAxis(chunk.x, local.x);
+		normalizeAxis(chunk.y, local.y);
+	}
+};
\ No newline at end of file